@@ -0,0 +1,138 @@
+use std::{
+    net::{TcpListener, TcpStream, SocketAddr, IpAddr, Ipv4Addr},
+    os::unix::{net::{UnixListener, UnixStream}, io::FromRawFd, ffi::OsStrExt},
+    io::{self, Read, Write},
+    path::Path, time::Duration,
+};
+
+/**************************
+ * CONSTANTS
+***************************/
+
+const AF_UNIX: i32 = 1;
+const SOCK_SEQPACKET: i32 = 5;
+const SUN_PATH_LEN: usize = 108;
+
+/**************************
+ * FFI
+***************************/
+
+#[repr(C)]
+struct SockAddrUn {
+    sun_family: u16,
+    sun_path: [u8; SUN_PATH_LEN],
+}
+
+extern "C" {
+    fn socket(domain: i32, ty: i32, protocol: i32) -> i32;
+    fn bind(fd: i32, addr: *const SockAddrUn, len: u32) -> i32;
+    fn listen(fd: i32, backlog: i32) -> i32;
+    fn close(fd: i32) -> i32;
+}
+
+/**************************
+ * STRUCTURES
+***************************/
+
+/// Listener for one router link, either a TCP port or a unix `SOCK_SEQPACKET` socket.
+pub enum LinkListener {
+    Tcp(TcpListener),
+    Unix(UnixListener),
+}
+
+/// Connection to one router link.
+/// Over a unix `SOCK_SEQPACKET` socket every read returns exactly one packet.
+pub enum LinkStream {
+    Tcp(TcpStream),
+    Unix(UnixStream),
+}
+
+/**************************
+ * IMPLEMENTATIONS
+***************************/
+
+impl LinkListener {
+    pub fn bind_tcp(addr: SocketAddr) -> io::Result<Self> {
+        Ok(Self::Tcp(TcpListener::bind(addr)?))
+    }
+
+    /// std only offers stream unix sockets, so the seqpacket listener is created by hand.
+    /// Accepting from it through `UnixListener` works as is.
+    pub fn bind_unix(path: &Path) -> io::Result<Self> {
+        let path_bytes = path.as_os_str().as_bytes();
+        if path_bytes.len() >= SUN_PATH_LEN {
+            return Err(io::Error::new(io::ErrorKind::InvalidInput, "unix socket path too long"));
+        }
+
+        let mut addr = SockAddrUn { sun_family: AF_UNIX as u16, sun_path: [0; SUN_PATH_LEN] };
+        addr.sun_path[..path_bytes.len()].copy_from_slice(path_bytes);
+
+        // Remove any stale socket file from an earlier run.
+        let _ = std::fs::remove_file(path);
+
+        unsafe {
+            let fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+            if fd < 0 {
+                return Err(io::Error::last_os_error());
+            }
+            if bind(fd, &addr, std::mem::size_of::<SockAddrUn>() as u32) < 0 || listen(fd, 0) < 0 {
+                let e = io::Error::last_os_error();
+                close(fd);
+                return Err(e);
+            }
+            Ok(Self::Unix(UnixListener::from_raw_fd(fd)))
+        }
+    }
+
+    /// Unix peers are always on this host, so they are reported as the loopback address.
+    pub fn accept(&self) -> io::Result<(LinkStream, IpAddr)> {
+        match self {
+            Self::Tcp(listener) => {
+                let (stream, addr) = listener.accept()?;
+                Ok((LinkStream::Tcp(stream), addr.ip()))
+            },
+            Self::Unix(listener) => {
+                let (stream, _) = listener.accept()?;
+                Ok((LinkStream::Unix(stream), IpAddr::V4(Ipv4Addr::LOCALHOST)))
+            },
+        }
+    }
+}
+
+impl LinkStream {
+    pub fn set_read_timeout(&self, timeout: Option<Duration>) -> io::Result<()> {
+        match self {
+            Self::Tcp(stream) => stream.set_read_timeout(timeout),
+            Self::Unix(stream) => stream.set_read_timeout(timeout),
+        }
+    }
+}
+
+/******************************************
+ * STANDARD LIBRARY TRAIT IMPLEMENTATIONS
+*******************************************/
+
+impl Read for LinkStream {
+    fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+        match self {
+            Self::Tcp(stream) => stream.read(buf),
+            Self::Unix(stream) => stream.read(buf),
+        }
+    }
+}
+
+impl Write for LinkStream {
+    fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+        match self {
+            Self::Tcp(stream) => stream.write(buf),
+            Self::Unix(stream) => stream.write(buf),
+        }
+    }
+
+    fn flush(&mut self) -> io::Result<()> {
+        match self {
+            Self::Tcp(stream) => stream.flush(),
+            Self::Unix(stream) => stream.flush(),
+        }
+    }
+}
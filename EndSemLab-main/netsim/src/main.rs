@@ -1,19 +1,20 @@
 use std::{
-    net::{TcpListener, TcpStream, SocketAddr, Ipv4Addr, IpAddr},
-    thread, sync::{Arc, Mutex}, collections::HashMap, str::FromStr,
+    net::{TcpListener, SocketAddr, Ipv4Addr, IpAddr},
+    thread, sync::{Arc, Mutex, atomic::{AtomicUsize, Ordering}}, collections::HashMap, str::FromStr, path::Path,
 };
 
 use tests::Tester;
 
-use crate::error::ErrorHandler;
+use crate::{error::ErrorHandler, link::{LinkListener, LinkStream}};
 
 mod error;
+mod link;
 mod protocol;
 mod simulation;
 mod tests;
 
 /// IP -> (count of connections connected, array of connections).
-type ConnectionTable = HashMap::<IpAddr, (usize, Vec<Option<TcpStream>>)>;
+type ConnectionTable = HashMap::<IpAddr, (usize, Vec<Option<LinkStream>>)>;
 
 /**************************
  * CONSTANTS
@@ -22,15 +23,29 @@ type ConnectionTable = HashMap::<IpAddr, (usize, Vec<Option<TcpStream>>)>;
 const BASE_LINK_PORT: u16 = 10000;
 const ERROR_MSG_PORT: u16 = 22222;
 
-/// Should fit into a `u16`.
-const ROUTER_LINK_COUNT: usize = 4;
+/// Link count of the router when not given on the command line.
+const DEFAULT_ROUTER_LINK_COUNT: usize = 4;
+
+/// Should fit into a `u16` (the router itself allows at most 64).
+const MAX_ROUTER_LINK_COUNT: usize = 64;
+
+/**************************
+ * DATA
+***************************/
+
+static ROUTER_LINK_COUNT: AtomicUsize = AtomicUsize::new(DEFAULT_ROUTER_LINK_COUNT);
 
 /**************************
  * FUNCTIONS
 ***************************/
 
+/// Number of links of the router being simulated, set once at startup.
+pub fn router_link_count() -> usize {
+    ROUTER_LINK_COUNT.load(Ordering::Relaxed)
+}
+
 fn link_listen_thread(
-    listener: TcpListener,
+    listener: LinkListener,
     router_link: usize,
     connections: Arc<Mutex<ConnectionTable>>,
     error_handler: Arc<Mutex<ErrorHandler>>,
@@ -39,7 +54,7 @@ fn link_listen_thread(
     eprintln!("[*] Listening for router link {}", router_link);
 
     loop {
-        let (stream, addr) = match listener.accept() {
+        let (stream, ip) = match listener.accept() {
             Ok(result) => result,
             Err(e) => {
                 eprintln!("[*] WARN: accept failed: {}", e);
@@ -47,21 +62,21 @@ fn link_listen_thread(
             },
         };
 
-        eprintln!("[*] Accepted from {} at router link {}", addr.ip(), router_link);
+        eprintln!("[*] Accepted from {} at router link {}", ip, router_link);
 
         // Add accepted stream to connection table.
         let mut connections = expect_result_or_crash!(connections.lock(), "connections mutex lock");
-        let (conn_count, conn_vec) = connections.entry(addr.ip()).or_insert_with(|| {
-            let mut vec = Vec::with_capacity(ROUTER_LINK_COUNT);
-            for _ in 0..ROUTER_LINK_COUNT { vec.push(None); }
+        let (conn_count, conn_vec) = connections.entry(ip).or_insert_with(|| {
+            let mut vec = Vec::with_capacity(router_link_count());
+            for _ in 0..router_link_count() { vec.push(None); }
             (0, vec)
         });
         conn_vec[router_link] = Some(stream);
         *conn_count += 1;
 
         // If all router links have connected, start simulation.
-        if *conn_count == ROUTER_LINK_COUNT {
-            let (ip, (_, links)) = match connections.remove_entry(&addr.ip()) {
+        if *conn_count == router_link_count() {
+            let (ip, (_, links)) = match connections.remove_entry(&ip) {
                 Some(v) => v,
                 None => crash!("connection should have been in table"),
             };
@@ -72,7 +87,7 @@ fn link_listen_thread(
             thread::Builder::new()
                 .name(format!("simulation thread {}", ip))
                 .spawn(move || {
-                    let links: Vec<TcpStream> = links.into_iter()
+                    let links: Vec<LinkStream> = links.into_iter()
                         .map(|e| e.expect("link stream does not exist")).collect();
                     simulation::router_simulation(ip, links, error_handler, tester)
                 })
@@ -84,8 +99,22 @@ fn link_listen_thread(
 fn main() {
     let mut args = std::env::args();
     args.next();
-    let ip = args.next().expect("Expecting IP address as the first argument");
-    let ip = IpAddr::V4(Ipv4Addr::from_str(&ip).expect("Invalid IPv4 address"));
+    let ip = args.next().expect("Expecting IP address (or unix socket directory) as the first argument");
+
+    // A directory instead of an IP address means the links are unix `SOCK_SEQPACKET` sockets inside it,
+    // while the error port stays on the local host.
+    let socket_dir = if ip.starts_with('/') { Some(ip.clone()) } else { None };
+    let ip = match socket_dir {
+        Some(_) => IpAddr::V4(Ipv4Addr::LOCALHOST),
+        None => IpAddr::V4(Ipv4Addr::from_str(&ip).expect("Invalid IPv4 address")),
+    };
+
+    // The optional second argument is the number of links of the router (as in its config).
+    if let Some(link_count) = args.next() {
+        let link_count: usize = link_count.parse().expect("Invalid router link count");
+        assert!(link_count > 0 && link_count <= MAX_ROUTER_LINK_COUNT, "Router link count must be from 1 to {}", MAX_ROUTER_LINK_COUNT);
+        ROUTER_LINK_COUNT.store(link_count, Ordering::Relaxed);
+    }
 
     let tests_file = std::fs::read("./tests.json").expect("tests.json read failed");
     let tester = Arc::new(Tester::parse(&tests_file));
@@ -104,9 +133,15 @@ fn main() {
 
     let connections = Arc::new(Mutex::new(ConnectionTable::new()));
 
-    for link in 0..ROUTER_LINK_COUNT {
-        let addr = SocketAddr::new(ip, BASE_LINK_PORT + link as u16);
-        let listener = TcpListener::bind(addr).expect("bind failed");
+    if let Some(dir) = &socket_dir {
+        std::fs::create_dir_all(dir).expect("socket directory creation failed");
+    }
+
+    for link in 0..router_link_count() {
+        let listener = match &socket_dir {
+            Some(dir) => LinkListener::bind_unix(&Path::new(dir).join(format!("link{}", link))),
+            None => LinkListener::bind_tcp(SocketAddr::new(ip, BASE_LINK_PORT + link as u16)),
+        }.expect("bind failed");
         let connections = connections.clone();
         let error_handler = error_handler.clone();
         let tester = tester.clone();
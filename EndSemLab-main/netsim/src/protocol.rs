@@ -42,7 +42,9 @@ const TYPE_DATA: u8 = 8;
 //
 //  Offset      Size        Description
 //  0           1           No. of DV Table entries in this packet
-//  1           1           Upper 4 bits (4-7) - unused
+//  1           1           Bit 4 - Delta flag (routers with `delta_updates on`), not checked by the simulation
+//                          Bit 5 - MORE flag (vectors split across commands), not checked by the simulation
+//                          Bits 6-7 - unused
 //                          Lower 4 bits (0-3) - Highest 4 bits (out of 20) of timestamp (number of seconds since midnight)
 //  2           2           Lower 16 bits (out of 20) of timestamp
 //
@@ -1,5 +1,5 @@
 use std::{
-    net::{TcpStream, IpAddr},
+    net::IpAddr,
     io::{Read, Write, ErrorKind},
     thread::{self, JoinHandle}, time::Duration,
     sync::{Arc, Mutex, mpsc::{self, Receiver, Sender}}, collections::HashMap,
@@ -7,8 +7,8 @@ use std::{
 
 use crate::{
     error::ErrorHandler, expect_result_or_crash, crash, protocol::{RaniHeader, RaniPacket, validate_packets},
-    tests::{Tester, TestCase},
-    BASE_LINK_PORT, err_return,
+    tests::{Tester, TestCase}, link::LinkStream,
+    err_return,
 };
 
 /**************************
@@ -37,16 +37,12 @@ enum Message {
 fn link_handler(
     remote_ip: IpAddr,
     link_id: usize,
-    mut stream: TcpStream,
+    mut stream: LinkStream,
     rx: Receiver<Message>,
     tx: Sender<Message>,
 ) -> Result<(), ()> {
     err_return!(stream.set_read_timeout(Some(LINK_READ_TIMEOUT)), "stream read timeout");
-    let id = format!(
-        "{}:{}",
-        err_return!(stream.peer_addr(), "stream peer addr").ip(),
-        err_return!(stream.local_addr(), "stream local addr").port() % BASE_LINK_PORT,
-    );
+    let id = format!("{}:{}", remote_ip, link_id);
 
     loop {
         let message = err_return!(rx.recv(), "link channel receive failed");
@@ -267,7 +263,7 @@ fn simulation_cycle(
 
 pub fn router_simulation(
     remote_ip: IpAddr,
-    mut links: Vec<TcpStream>,
+    mut links: Vec<LinkStream>,
     error_handler: Arc<Mutex<ErrorHandler>>,
     tester: Arc<Tester>,
 ) -> Result<(), ()> {
@@ -329,7 +325,7 @@ fn cleanup_links(mut handles: Vec<JoinHandle<Result<(), ()>>>, mut channels: Vec
     }
 }
 
-fn validate_links(remote_ip: IpAddr, links: &mut Vec<TcpStream>) -> Result<(), ()>  {
+fn validate_links(remote_ip: IpAddr, links: &mut Vec<LinkStream>) -> Result<(), ()>  {
     for (i, link) in links.iter_mut().enumerate() {
         let mut buf = [0; 1];
         err_return!(link.read_exact(&mut buf), "link ID byte read");
@@ -79,7 +79,7 @@ impl From<Map<String, Value>> for TestCase {
                 }
             },
             Some(v) if v.is_u64() => vec![v.as_u64().unwrap().to_usize()],
-            Some(v) if v.is_string() && v.as_str().unwrap() == "all" => (0..crate::ROUTER_LINK_COUNT).collect(),
+            Some(v) if v.is_string() && v.as_str().unwrap() == "all" => (0..crate::router_link_count()).collect(),
             _ => panic!("u64 or \"all\" recv_link expected"),
         };
 
@@ -178,6 +178,8 @@ void print_log(FILE *log) {
                     case PACKET_DROP_OUTDATED_COMMAND: printf("Outdated Command"); break;
                     case PACKET_DROP_TTL_ZERO: printf("TTL Zero"); break;
                     case PACKET_DROP_TOO_LARGE: printf("Too Large"); break;
+                    case PACKET_DROP_RATE_LIMITED: printf("Rate Limited"); break;
+                    case PACKET_DROP_DUPLICATE: printf("Duplicate"); break;
                     case PACKET_DROP_GENERAL: printf("General"); break;
                     default: printf("[!] Invalid drop code"); break;
                 }
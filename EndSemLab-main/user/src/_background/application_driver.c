@@ -10,6 +10,7 @@
 #include "../include/packet.h"
 #include "../include/app_api.h"
 #include "include/log.h"
+#include "include/transport.h"
 
 #define expect(assertion, what_failed) do { if(!(assertion)) { print("[!] "); perror(what_failed); exit(1); } } while(0)
 
@@ -17,21 +18,21 @@
 //      CONSTANTS
 //=====================================
 
-#define APP_PORT 5000
 #define APP_INITIAL_BYTE 5
 
 //=====================================
 //      DATA
 //=====================================
 
-int router_sock = 0;
+// The link to the router served by the calling thread, one thread per router.
+static __thread transport_t *router_link;
 
 //=====================================
 //      API FUNCTIONS
 //=====================================
 
 int send_buffer_to_router(const uint8_t *buf, const uint8_t size) {
-    if(send(router_sock, buf, size, 0) != size) return -1;
+    if(transport_send(router_link, buf, size) != 0) return -1;
 
     // log
     log_send_to_router(buf, size);
@@ -43,16 +44,17 @@ int send_buffer_to_router(const uint8_t *buf, const uint8_t size) {
 //      FUNCTIONS
 //=====================================
 
-int application_loop(void) {
+void *application_loop(void *_link) {
+    router_link = _link;
+
     print("[*] Application initialised\n");
     uint8_t buf[MAX_PACKET_SIZE];
     int exit_code = 0;
 
     while(1) {
         memset(buf, 0, MAX_PACKET_SIZE);
-        ssize_t bytes_read = recv(router_sock, buf, MAX_PACKET_SIZE, 0);
+        ssize_t bytes_read = transport_recv(router_link, buf);
         expect(bytes_read >= 0, "link packet recv");
-        expect(bytes_read <= UINT8_MAX, "packet too big");
         uint8_t size = (uint8_t) bytes_read;
 
         if(size == 0) {
@@ -64,12 +66,12 @@ int application_loop(void) {
         int flag_end = (buf[3] & (1 << 5)) != 0;
 
         if(flag_err) {
-            expect(send(router_sock, buf, size, 0) == size, "ERR packet send");
+            expect(transport_send(router_link, buf, size) == 0, "ERR packet send");
             exit_code = 1;
             break;
         }
         else if(flag_end) {
-            expect(send(router_sock, buf, size, 0) == size, "END packet send");
+            expect(transport_send(router_link, buf, size) == 0, "END packet send");
             exit_code = 0;
             break;
         }
@@ -82,11 +84,17 @@ int application_loop(void) {
     }
 
     print("[*] Link with router closing down\n");
-    return exit_code;
+    return (void *) (long) exit_code;
 }
 
-int main() {
-    const char *router_ip = "127.0.0.1";
+int main(const int argc, const char *argv[]) {
+    // The number of routers to serve, which may all live in one router process.
+    int router_count = 1;
+    if(argc > 1) router_count = atoi(argv[1]);
+    if(router_count < 1) {
+        print("[!] Expecting the number of routers to be positive\n");
+        return 1;
+    }
 
     FILE *log_file = fopen("log/app_log", "ab");
     if(!log_file) {
@@ -95,43 +103,48 @@ int main() {
     }
     log_begin(log_file);
 
-    print("[*] Waiting for router connection...\n");
-
-    struct sockaddr_in addr = {};
-    addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = inet_addr(router_ip);
-    addr.sin_port = htons(APP_PORT);
-
-    // Accept connection from router.
-    int listen_sock = socket(AF_INET, SOCK_STREAM, 0);
-    expect(listen_sock >= 0, "router socket");
-    expect(setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &(int){1}, sizeof(int)) >= 0, "REUSEADDR option");
-    expect(setsockopt(listen_sock, SOL_SOCKET, SO_REUSEPORT, &(int){1}, sizeof(int)) >= 0, "REUSEPORT option");
-
-    expect(bind(listen_sock, (struct sockaddr *) &addr, sizeof(addr)) >= 0, "bind");
-    expect(listen(listen_sock, 0) >= 0, "listen");
-    socklen_t addr_len = 0;
-    router_sock = accept(listen_sock, (struct sockaddr *) &addr, &addr_len);
-    expect(router_sock >= 0, "accept");
-
-    // Receive initial byte.
-    uint8_t byte = 0;
-    expect(recv(router_sock, &byte, sizeof(byte), 0) > 0, "router initial byte recv");
-    if(byte != APP_INITIAL_BYTE) {
-        print("[!] Invalid router initial byte");
+    const char *router_link_type = getenv(APP_LINK_ENV);
+    if(!router_link_type) router_link_type = transport_tcp.name;
+
+    const transport_ops_t *transport = transport_find(router_link_type);
+    if(!transport) {
+        print("[!] Unknown router link transport '%s'\n", router_link_type);
         exit(1);
     }
 
-    print("[*] Link established with router\n");
-    int status = application_loop();
+    const char *address = APP_TCP_ADDRESS;
+    if(transport == &transport_unix) address = APP_SOCKET_PATH;
+    else if(transport == &transport_shm) address = APP_SHM_SOCKET_PATH;
+
+    transport_t *links = calloc(router_count, sizeof(transport_t));
+    pthread_t *threads = calloc(router_count, sizeof(pthread_t));
+    expect(links && threads, "router link allocation");
+
+    for(int i = 0; i < router_count; i++) {
+        print("[*] Waiting for router connection...\n");
+
+        // Accept connection from router, which must begin with the initial byte.
+        expect(transport_open(&links[i], transport, address, TRANSPORT_ACCEPT, APP_INITIAL_BYTE) == 0, "router link open");
+        print("[*] Link established with router (%s)\n", transport->name);
+
+        expect(pthread_create(&threads[i], NULL, application_loop, &links[i]) == 0, "thread create");
+    }
+
+    int status = 0;
+    for(int i = 0; i < router_count; i++) {
+        void *retval;
+        pthread_join(threads[i], &retval);
+        status |= (int) (long) retval;
 
-    // Close all sockets.
-    close(router_sock);
-    close(listen_sock);
+        // Close the link.
+        transport_close(&links[i]);
+    }
+    free(links);
+    free(threads);
 
     log_end();
 
     print("[*] Application ended\n");
 
     return status;
-}
\ No newline at end of file
+}
@@ -1,5 +1,6 @@
 #include <stdint.h>
 #include "include/log.h"
+#include "include/stats.h"
 
 //=====================================
 //      FUNCTIONS
@@ -7,4 +8,5 @@
 
 void packet_drop(const uint8_t drop_code) {
     log_drop(drop_code);
+    stats_count_drop(drop_code);
 }
\ No newline at end of file
@@ -0,0 +1,333 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/common.h"
+#include "../include/router_api.h"
+#include "include/config.h"
+
+//=====================================
+//      MACROS
+//=====================================
+
+#define config_error(...) do { print("[!] %s:%u: ", name, line_number); print(__VA_ARGS__); print("\n"); } while(0)
+
+//=====================================
+//      CONSTANTS
+//=====================================
+
+#define CONFIG_LINE_MAX 512
+#define CONFIG_VALUES_MAX 4
+
+//=====================================
+//      HELPERS
+//=====================================
+
+static int parse_u32(const char *value, const unsigned long min, const unsigned long max, uint32_t *out) {
+    char *end;
+    const unsigned long parsed = strtoul(value, &end, 0);
+    if(end == value || *end || parsed < min || parsed > max) return -1;
+    *out = (uint32_t) parsed;
+    return 0;
+}
+
+static int parse_u8(const char *value, const unsigned int min, const unsigned int max, uint8_t *out) {
+    uint32_t parsed;
+    if(parse_u32(value, min, max, &parsed) != 0) return -1;
+    *out = (uint8_t) parsed;
+    return 0;
+}
+
+static int parse_switch(const char *value, uint8_t *out) {
+    if(strcmp(value, "on") == 0) *out = 1;
+    else if(strcmp(value, "off") == 0) *out = 0;
+    else return -1;
+    return 0;
+}
+
+static int router_add(config_t *config) {
+    router_config_t *routers = realloc(config->routers, sizeof(router_config_t) * (config->router_count + 1));
+    if(!routers) return -1;
+
+    config->routers = routers;
+    memset(&routers[config->router_count], 0, sizeof(router_config_t));
+    routers[config->router_count].address_bits = CONFIG_MIN_ADDRESS_BITS;
+    routers[config->router_count].hello_multiplier = CONFIG_DEFAULT_HELLO_MULTIPLIER;
+    routers[config->router_count].stale_ms = CONFIG_DEFAULT_STALE_MS;
+    config->router_count += 1;
+    return 0;
+}
+
+static int link_add(router_config_t *router, const link_config_t *link) {
+    link_config_t *links = realloc(router->links, sizeof(link_config_t) * (router->link_count + 1));
+    if(!links) return -1;
+
+    router->links = links;
+    router->links[router->link_count] = *link;
+    router->link_count += 1;
+    return 0;
+}
+
+//=====================================
+//      FUNCTIONS
+//=====================================
+
+int config_parse(config_t *config, FILE *file, const char *name) {
+    memset(config, 0, sizeof(*config));
+
+    char line[CONFIG_LINE_MAX];
+    unsigned int line_number = 0;
+    while(fgets(line, sizeof(line), file)) {
+        line_number += 1;
+
+        char *comment = strchr(line, '#');
+        if(comment) *comment = 0;
+
+        char *save;
+        const char *key = strtok_r(line, " \t\r\n", &save);
+        if(!key) continue;
+
+        const char *values[CONFIG_VALUES_MAX];
+        int value_count = 0;
+        const char *value;
+        while((value = strtok_r(NULL, " \t\r\n", &save))) {
+            if(value_count == CONFIG_VALUES_MAX) {
+                config_error("Too many values for `%s`", key);
+                goto fail;
+            }
+            values[value_count++] = value;
+        }
+
+        if(strcmp(key, "router") == 0) {
+            if(router_add(config) != 0) {
+                config_error("Out of memory");
+                goto fail;
+            }
+            continue;
+        }
+
+        if(config->router_count == 0) {
+            config_error("`%s` must follow a `router` line", key);
+            goto fail;
+        }
+        router_config_t *router = &config->routers[config->router_count - 1];
+
+        if(strcmp(key, "netsim") == 0 && value_count == 1) {
+            if(strlen(values[0]) >= sizeof(router->netsim_address)) {
+                config_error("Network simulation address is too long");
+                goto fail;
+            }
+            strcpy(router->netsim_address, values[0]);
+        }
+        else if(strcmp(key, "address") == 0 && value_count == 1) {
+            if(parse_u8(values[0], 0, UINT8_MAX, &router->address) != 0) {
+                config_error("Invalid address '%s'", values[0]);
+                goto fail;
+            }
+        }
+        else if(strcmp(key, "app_address") == 0 && value_count == 1) {
+            if(parse_u8(values[0], 0, UINT8_MAX, &router->app_address) != 0) {
+                config_error("Invalid application address '%s'", values[0]);
+                goto fail;
+            }
+        }
+        else if(strcmp(key, "link") == 0 && value_count == 2) {
+            link_config_t link;
+            // The subnet is checked against `address_bits` once the whole router is read.
+            if(parse_u32(values[0], 0, (UINT32_C(1) << CONFIG_MAX_ADDRESS_BITS) - 1, &link.neighbour_subnet) != 0 ||
+                parse_u8(values[1], 0, UINT8_MAX, &link.weight) != 0) {
+                config_error("Invalid link '%s %s'", values[0], values[1]);
+                goto fail;
+            }
+            if(router->link_count == CONFIG_MAX_LINK_COUNT) {
+                config_error("A router can have at most %d links", CONFIG_MAX_LINK_COUNT);
+                goto fail;
+            }
+            if(link_add(router, &link) != 0) {
+                config_error("Out of memory");
+                goto fail;
+            }
+        }
+        else if(strcmp(key, "address_bits") == 0 && value_count == 1) {
+            if(parse_u8(values[0], CONFIG_MIN_ADDRESS_BITS, CONFIG_MAX_ADDRESS_BITS, &router->address_bits) != 0) {
+                config_error("Address bits must be from %d to %d", CONFIG_MIN_ADDRESS_BITS, CONFIG_MAX_ADDRESS_BITS);
+                goto fail;
+            }
+        }
+        else if(strcmp(key, "rate_limit") == 0 && value_count == 4) {
+            rate_class_t class;
+            rate_scope_t scope;
+            if(strcmp(values[0], "cmd") == 0) class = RATE_CLASS_COMMAND;
+            else if(strcmp(values[0], "data") == 0) class = RATE_CLASS_DATA;
+            else {
+                config_error("Rate limit class must be `cmd` or `data`");
+                goto fail;
+            }
+            if(strcmp(values[1], "link") == 0) scope = RATE_SCOPE_LINK;
+            else if(strcmp(values[1], "source") == 0) scope = RATE_SCOPE_SOURCE;
+            else {
+                config_error("Rate limit scope must be `link` or `source`");
+                goto fail;
+            }
+
+            rate_limit_t *limit = &router->rate_limits[class][scope];
+            if(parse_u32(values[2], 0, UINT32_MAX, &limit->rate) != 0 || parse_u32(values[3], 1, UINT32_MAX, &limit->burst) != 0) {
+                config_error("Invalid rate limit '%s %s'", values[2], values[3]);
+                goto fail;
+            }
+        }
+        else if(strcmp(key, "split_horizon") == 0 && value_count == 1) {
+            if(strcmp(values[0], "poison") == 0) router->split_horizon = SPLIT_HORIZON_POISON_REVERSE;
+            else if(parse_switch(values[0], &router->split_horizon) != 0) {
+                config_error("Split horizon must be `off`, `on` or `poison`");
+                goto fail;
+            }
+        }
+        else if(strcmp(key, "delta_updates") == 0 && value_count == 1) {
+            if(parse_switch(values[0], &router->delta_updates) != 0) {
+                config_error("Delta updates must be `off` or `on`");
+                goto fail;
+            }
+        }
+        else if(strcmp(key, "coalesce_ms") == 0 && value_count == 1) {
+            if(parse_u32(values[0], 0, CONFIG_MAX_COALESCE_MS, &router->coalesce_ms) != 0) {
+                config_error("Coalescing window must be from 0 to %d milliseconds", CONFIG_MAX_COALESCE_MS);
+                goto fail;
+            }
+        }
+        else if(strcmp(key, "refresh_ms") == 0 && value_count == 1) {
+            if(parse_u32(values[0], 0, CONFIG_MAX_TIMER_MS, &router->refresh_ms) != 0) {
+                config_error("Refresh interval must be from 0 to %d milliseconds", CONFIG_MAX_TIMER_MS);
+                goto fail;
+            }
+        }
+        else if(strcmp(key, "route_timeout_ms") == 0 && value_count == 1) {
+            if(parse_u32(values[0], 0, CONFIG_MAX_TIMER_MS, &router->route_timeout_ms) != 0) {
+                config_error("Route timeout must be from 0 to %d milliseconds", CONFIG_MAX_TIMER_MS);
+                goto fail;
+            }
+        }
+        else if(strcmp(key, "holddown_ms") == 0 && value_count == 1) {
+            if(parse_u32(values[0], 0, CONFIG_MAX_TIMER_MS, &router->holddown_ms) != 0) {
+                config_error("Hold-down time must be from 0 to %d milliseconds", CONFIG_MAX_TIMER_MS);
+                goto fail;
+            }
+        }
+        else if(strcmp(key, "hello_ms") == 0 && value_count == 1) {
+            if(parse_u32(values[0], 0, CONFIG_MAX_HELLO_MS, &router->hello_ms) != 0) {
+                config_error("Hello interval must be from 0 to %d milliseconds", CONFIG_MAX_HELLO_MS);
+                goto fail;
+            }
+        }
+        else if(strcmp(key, "hello_multiplier") == 0 && value_count == 1) {
+            if(parse_u8(values[0], 1, UINT8_MAX, &router->hello_multiplier) != 0) {
+                config_error("Hello multiplier must be from 1 to %d", UINT8_MAX);
+                goto fail;
+            }
+        }
+        else if(strcmp(key, "state_file") == 0 && value_count == 1) {
+            if(strlen(values[0]) >= sizeof(router->state_file)) {
+                config_error("State file path is too long");
+                goto fail;
+            }
+            strcpy(router->state_file, values[0]);
+        }
+        else if(strcmp(key, "stale_ms") == 0 && value_count == 1) {
+            if(parse_u32(values[0], 0, CONFIG_MAX_TIMER_MS, &router->stale_ms) != 0) {
+                config_error("Stale time must be from 0 to %d milliseconds", CONFIG_MAX_TIMER_MS);
+                goto fail;
+            }
+        }
+        else if(strcmp(key, "duplicate_ms") == 0 && value_count == 1) {
+            if(parse_u32(values[0], 0, CONFIG_MAX_DUPLICATE_MS, &router->duplicate_ms) != 0) {
+                config_error("Duplicate window must be from 0 to %d milliseconds", CONFIG_MAX_DUPLICATE_MS);
+                goto fail;
+            }
+        }
+        else if(strcmp(key, "latency_cost_ms") == 0 && value_count == 1) {
+            if(parse_u32(values[0], 0, CONFIG_MAX_LATENCY_COST_MS, &router->latency_cost_ms) != 0) {
+                config_error("Latency cost must be from 0 to %d milliseconds", CONFIG_MAX_LATENCY_COST_MS);
+                goto fail;
+            }
+        }
+        else if(strcmp(key, "queue_cost_bytes") == 0 && value_count == 1) {
+            if(parse_u32(values[0], 0, UINT32_MAX, &router->queue_cost_bytes) != 0) {
+                config_error("Invalid queue cost '%s'", values[0]);
+                goto fail;
+            }
+        }
+        else if(strcmp(key, "multicast") == 0 && value_count == 2) {
+            uint8_t group;
+            uint8_t link;
+            const int is_app = strcmp(values[1], "app") == 0;
+            if(parse_u8(values[0], 0, UINT8_MAX, &group) != 0) {
+                config_error("Invalid multicast group address '%s'", values[0]);
+                goto fail;
+            }
+            if(!is_app && (parse_u8(values[1], 0, UINT8_MAX, &link) != 0 || link >= router->link_count)) {
+                config_error("Multicast member must be `app` or a link declared before, not '%s'", values[1]);
+                goto fail;
+            }
+
+            if(is_app) router->multicast_app[group / 64] |= UINT64_C(1) << (group % 64);
+            else router->multicast_links[group] |= UINT64_C(1) << link;
+            router->multicast_groups[group / 64] |= UINT64_C(1) << (group % 64);
+        }
+        else if(strcmp(key, "stats") == 0 && value_count == 1) {
+            if(strlen(values[0]) > CONFIG_STATS_NAME_MAX || strchr(values[0], '/')) {
+                config_error("Stats name must have at most %d characters and no `/`", CONFIG_STATS_NAME_MAX);
+                goto fail;
+            }
+            strcpy(router->stats_name, values[0]);
+        }
+        else {
+            config_error("Unknown key `%s` or wrong number of values", key);
+            goto fail;
+        }
+    }
+
+    if(config->router_count == 0) {
+        print("[!] %s: No routers configured\n", name);
+        goto fail;
+    }
+
+    for(uint32_t i = 0; i < config->router_count; i++) {
+        const router_config_t *router = &config->routers[i];
+        if(!router->netsim_address[0] || router->link_count == 0) {
+            print("[!] %s: Router %u needs a `netsim` address and at least one `link`\n", name, i);
+            goto fail;
+        }
+        for(uint8_t link = 0; link < router->link_count; link++) {
+            if(router->links[link].neighbour_subnet >> router->address_bits) {
+                print("[!] %s: Router %u link %u: Neighbour subnet is wider than %u bits\n", name, i, link, router->address_bits);
+                goto fail;
+            }
+        }
+    }
+
+    return 0;
+
+fail:
+    config_free(config);
+    return -1;
+}
+
+int config_load(config_t *config, const char *path) {
+    FILE *file = fopen(path, "r");
+    if(!file) {
+        perror(path);
+        return -1;
+    }
+
+    const int status = config_parse(config, file, path);
+    fclose(file);
+    return status;
+}
+
+void config_free(config_t *config) {
+    for(uint32_t i = 0; i < config->router_count; i++) {
+        free(config->routers[i].links);
+    }
+    free(config->routers);
+    memset(config, 0, sizeof(*config));
+}
@@ -0,0 +1,170 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "rate_limit.h"
+
+//=====================================
+//      MACROS
+//=====================================
+
+// Bounded by the 64-bit link masks of `send_buffer_to_links()`.
+#define CONFIG_MAX_LINK_COUNT 64
+
+#define CONFIG_ADDRESS_MAX 256
+#define CONFIG_PATH_MAX 256
+
+// Destination subnets in the routing table are `CONFIG_MIN_ADDRESS_BITS` wide unless set with `address_bits`.
+// Bounded by `LPM_MAX_ADDRESS_BITS`.
+#define CONFIG_MIN_ADDRESS_BITS 6
+#define CONFIG_MAX_ADDRESS_BITS 24
+
+#define CONFIG_MAX_COALESCE_MS 1000
+#define CONFIG_MAX_TIMER_MS 3600000
+
+// Hello intervals are sent as 16 bits.
+#define CONFIG_MAX_HELLO_MS 60000
+#define CONFIG_DEFAULT_HELLO_MULTIPLIER 3
+
+#define CONFIG_DEFAULT_STALE_MS 30000
+
+#define CONFIG_MAX_DUPLICATE_MS 60000
+
+// Hello timestamps wrap every 65536 milliseconds.
+#define CONFIG_MAX_LATENCY_COST_MS 60000
+
+// Bounded by `STATS_NAME_MAX`.
+#define CONFIG_STATS_NAME_MAX 200
+
+// Any 8-bit packet destination can be made a multicast group.
+#define CONFIG_MULTICAST_ADDRESSES 256
+
+//=====================================
+//      STRUCTURES
+//=====================================
+//
+//  Config file format:
+//  One `<key> <values...>` per line. Everything after a `#` is a comment.
+//  Each `router` line begins a new router; the keys after it apply to that router.
+//
+//  Key             Values                          Description
+//  router                                          Begins a router.
+//  netsim          <ipv4 address or directory>     Where the router's network simulation listens.
+//  address         <8-bit address>                 Address of the router. Its upper 6 bits are the router's own subnet.
+//  app_address     <8-bit address>                 Address of the application behind the router.
+//  link            <neighbour subnet> <weight>     Adds the next link, numbered from 0 in the order given.
+//  address_bits    <6 to 24>                       Width of destination subnets in the routing table (default 6).
+//                                                  Packets only carry 6-bit subnets.
+//  rate_limit      <cmd|data> <link|source>        Limits packets arriving on each link, or from each source address,
+//                  <packets per second> <burst>    to the given rate. Over the limit they are dropped. (Default: no limit)
+//  split_horizon   <off|on|poison>                 Leaves routes out of the vector sent back to the link they were
+//                                                  learnt from, or sends them as unreachable with `poison`. (Default: off)
+//  delta_updates   <off|on>                        Advertises only the entries that changed. (Default: off)
+//  coalesce_ms     <0 to 1000>                     Merges the table changes made within this many milliseconds
+//                                                  into one advertisement per link. (Default: 0, no merging)
+//  refresh_ms      <0 to 3600000>                  Advertises the whole table this often, even if it did not change.
+//                                                  (Default: 0, only on changes)
+//  route_timeout_ms <0 to 3600000>                 Drops a route learnt on a link once the neighbour has not
+//                                                  advertised it for this long. (Default: 0, routes never expire)
+//  holddown_ms     <0 to 3600000>                  Takes no new route to a lost destination for this long.
+//                                                  (Default: 0, no hold-down)
+//  hello_ms        <0 to 60000>                    Sends a hello over every link this often, and takes a link down
+//                                                  (withdrawing its routes) when its neighbour's hellos stop.
+//                                                  (Default: 0, no hellos, links are always up)
+//  hello_multiplier <1 to 255>                     Hello intervals missed before the neighbour takes this router's
+//                                                  link down. (Default: 3)
+//  state_file      <path>                          Keeps the routing table and command timestamps in this file,
+//                                                  and reloads them on the next start (if the router's address
+//                                                  and links are unchanged). (Default: none, always a cold start)
+//  stale_ms        <0 to 3600000>                  Withdraws reloaded routes no neighbour has confirmed by then.
+//                                                  0 keeps them until replaced. (Default: 30000)
+//  duplicate_ms    <0 to 60000>                    Drops a data packet seen on another link within this many
+//                                                  milliseconds, as it is looping. (Default: 0, never dropped)
+//  latency_cost_ms <0 to 60000>                    Adds 1 to a link's weight for every this many milliseconds of
+//                                                  smoothed round trip time, measured with hellos (so `hello_ms`
+//                                                  must be set). (Default: 0, latency is ignored)
+//  queue_cost_bytes <0 to 4294967295>              Adds 1 to a link's weight for every this many bytes waiting in its
+//                                                  send queue, smoothed, sampled with every hello. (Default: 0, ignored)
+//  multicast       <8-bit group address>           Adds a member to a multicast group: a link (declared before),
+//                  <link|app>                      or the application. Data packets to the group are sent to every
+//                                                  member but the one they came from. One line per member.
+//  stats           <name>                          Publishes packet and drop counters of each link and thread in the
+//                                                  shared memory segment `/rani_stats_<name>`, read with `make stats`.
+//                                                  (Default: none, the counters are kept private)
+//
+//  Example:
+//      router
+//      netsim 127.0.0.1
+//      address 12
+//      app_address 14
+//      link 2 2
+//      link 5 3
+//
+
+typedef struct link_config {
+    // Subnet (`address_bits` wide) at the other end of the link.
+    uint32_t neighbour_subnet;
+    uint8_t weight;
+} link_config_t;
+
+typedef struct router_config {
+    char netsim_address[CONFIG_ADDRESS_MAX];
+    uint8_t address;
+    uint8_t app_address;
+    uint8_t address_bits;
+
+    rate_limit_t rate_limits[RATE_CLASS_COUNT][RATE_SCOPE_COUNT];
+
+    // One of the `SPLIT_HORIZON_*` values of `router_api.h`.
+    uint8_t split_horizon;
+    uint8_t delta_updates;
+    uint32_t coalesce_ms;
+    uint32_t refresh_ms;
+    uint32_t route_timeout_ms;
+    uint32_t holddown_ms;
+    uint32_t hello_ms;
+    uint8_t hello_multiplier;
+    char state_file[CONFIG_PATH_MAX];
+    uint32_t stale_ms;
+    uint32_t duplicate_ms;
+    uint32_t latency_cost_ms;
+    uint32_t queue_cost_bytes;
+
+    // Members of each multicast group address: links (bit `i` set for link `i`), and the application (bit set per address).
+    uint64_t multicast_links[CONFIG_MULTICAST_ADDRESSES];
+    uint64_t multicast_app[CONFIG_MULTICAST_ADDRESSES / 64];
+    // Bit set for each address which is a group.
+    uint64_t multicast_groups[CONFIG_MULTICAST_ADDRESSES / 64];
+
+    char stats_name[CONFIG_STATS_NAME_MAX + 1];
+
+    uint8_t link_count;
+    link_config_t *links;
+} router_config_t;
+
+typedef struct config {
+    uint32_t router_count;
+    router_config_t *routers;
+} config_t;
+
+//=====================================
+//      FUNCTIONS
+//=====================================
+
+/**
+ * Parses a config.
+ * `file` - The config to read.
+ * `name` - Name of the config, used in error messages.
+ * Return Value - 0 if the config was valid, else -1 (with the reason printed).
+ */
+int config_parse(config_t *config, FILE *file, const char *name);
+
+/**
+ * Parses the config file at `path` (See `config_parse()`).
+ */
+int config_load(config_t *config, const char *path);
+
+void config_free(config_t *config);
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef LPM_H
+#define LPM_H
+
+#include <stdint.h>
+
+//=====================================
+//      MACROS
+//=====================================
+
+// Widest address the table supports: 16 bits resolved by the first level, 8 by the second.
+#define LPM_MAX_ADDRESS_BITS 24
+#define LPM_L1_MAX_BITS 16
+
+// Routes are 24-bit values chosen by the caller.
+#define LPM_MAX_ROUTE ((UINT32_C(1) << 24) - 1)
+#define LPM_NO_ROUTE UINT32_MAX
+
+//  Table entry format (32 bits):
+//  Bit 31      - Valid
+//  Bit 30      - Extended (first level only): the address continues in second level group `route`
+//  Bits 24-29  - Depth: length of the prefix that set the entry
+//  Bits 0-23   - Route, or second level group
+#define LPM_ENTRY_VALID (UINT32_C(1) << 31)
+#define LPM_ENTRY_EXTENDED (UINT32_C(1) << 30)
+#define LPM_ENTRY_ROUTE(entry) ((entry) & LPM_MAX_ROUTE)
+
+//=====================================
+//      STRUCTURES
+//=====================================
+
+/**
+ * Longest prefix match table in the style of DIR-24-8.
+ * The first level is indexed by the upper `l1_bits` of an address. Entries covered by a prefix longer than
+ * `l1_bits` point to a group of `1 << l2_bits` second level entries indexed by the rest of the address.
+ * A lookup therefore reads at most two entries, however many prefixes there are.
+ */
+typedef struct lpm_table {
+    uint8_t address_bits;
+    uint8_t l1_bits;
+    uint8_t l2_bits;
+
+    uint32_t *l1;
+    uint32_t *l2;
+    uint32_t l2_group_count;
+    uint32_t l2_group_capacity;
+
+    // Every prefix added, keyed by prefix and length, so a deleted prefix can be replaced by the one covering it.
+    uint32_t *rule_keys;
+    uint32_t *rule_routes;
+    uint32_t rule_capacity;
+    uint32_t rule_used;
+} lpm_table_t;
+
+//=====================================
+//      FUNCTIONS
+//=====================================
+
+/**
+ * `address_bits` - Width of the addresses, from 1 to `LPM_MAX_ADDRESS_BITS`.
+ * Return Value - 0 on success, else -1.
+ */
+int lpm_init(lpm_table_t *table, const uint8_t address_bits);
+
+void lpm_free(lpm_table_t *table);
+
+/**
+ * Adds a prefix, or changes the route of a prefix already added.
+ * `prefix` - The address whose upper `prefix_len` bits form the prefix. The other bits are ignored.
+ * `route` - At most `LPM_MAX_ROUTE`.
+ * Return Value - 0 on success, else -1.
+ */
+int lpm_add(lpm_table_t *table, const uint32_t prefix, const uint8_t prefix_len, const uint32_t route);
+
+/**
+ * Removes a prefix. Addresses it covered fall back to the next longest prefix covering them.
+ * Return Value - 0 if the prefix was removed, -1 if it was not in the table.
+ */
+int lpm_delete(lpm_table_t *table, const uint32_t prefix, const uint8_t prefix_len);
+
+/**
+ * Return Value - The route of exactly this prefix, or `LPM_NO_ROUTE`.
+ */
+uint32_t lpm_find(const lpm_table_t *table, const uint32_t prefix, const uint8_t prefix_len);
+
+/**
+ * Return Value - The route of the longest prefix containing `address`, or `LPM_NO_ROUTE`.
+ */
+static inline uint32_t lpm_lookup(const lpm_table_t *table, const uint32_t address) {
+    const uint32_t l2_mask = (UINT32_C(1) << table->l2_bits) - 1;
+
+    uint32_t entry = table->l1[(address >> table->l2_bits) & ((UINT32_C(1) << table->l1_bits) - 1)];
+    if(entry & LPM_ENTRY_EXTENDED) {
+        entry = table->l2[(LPM_ENTRY_ROUTE(entry) << table->l2_bits) | (address & l2_mask)];
+    }
+
+    return (entry & LPM_ENTRY_VALID) ? LPM_ENTRY_ROUTE(entry) : LPM_NO_ROUTE;
+}
+
+#endif
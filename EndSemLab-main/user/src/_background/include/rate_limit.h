@@ -0,0 +1,63 @@
+#ifndef RATE_LIMIT_H
+#define RATE_LIMIT_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+//=====================================
+//      MACROS
+//=====================================
+
+// Source addresses are 8 bits.
+#define RATE_LIMIT_SOURCE_COUNT 256
+
+//=====================================
+//      STRUCTURES
+//=====================================
+
+// Traffic is limited separately per class, so a command flood cannot starve data forwarding.
+typedef enum rate_class {
+    RATE_CLASS_COMMAND,
+    RATE_CLASS_DATA,
+    RATE_CLASS_COUNT,
+} rate_class_t;
+
+// Whether a limit applies to everything arriving on one link, or to everything from one source address.
+typedef enum rate_scope {
+    RATE_SCOPE_LINK,
+    RATE_SCOPE_SOURCE,
+    RATE_SCOPE_COUNT,
+} rate_scope_t;
+
+typedef struct rate_limit {
+    // Packets per second, 0 for no limit.
+    uint32_t rate;
+    // Packets allowed back to back after a quiet period.
+    uint32_t burst;
+} rate_limit_t;
+
+/**
+ * Token bucket kept as the time at which it will be full again (the generic cell rate algorithm),
+ * so taking a token is a single compare and swap, however many threads share the bucket.
+ */
+typedef struct token_bucket {
+    _Atomic uint64_t full_at_ns;
+} token_bucket_t;
+
+//=====================================
+//      FUNCTIONS
+//=====================================
+
+/**
+ * Return Value - The current time of the clock buckets are filled by, in nanoseconds.
+ */
+uint64_t rate_limit_now(void);
+
+/**
+ * Takes a token from a bucket filled at the rate of `limit`.
+ * `now_ns` - The time from `rate_limit_now()`.
+ * Return Value - 1 if a token was taken (or there is no limit), 0 if the bucket is empty.
+ */
+int token_bucket_take(token_bucket_t *bucket, const rate_limit_t *limit, const uint64_t now_ns);
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef SHM_LINK_H
+#define SHM_LINK_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "../../include/packet.h"
+
+//=====================================
+//      MACROS
+//=====================================
+
+// Number of packet slots in each ring. Must be a power of two.
+#define SHM_RING_SLOTS 256
+
+#define CACHE_LINE_SIZE 64
+
+// Yields a sender waits through on a full ring between checks that the consumer is still there.
+#define SHM_PEER_CHECK_SPINS 64
+
+//=====================================
+//      STRUCTURES
+//=====================================
+
+typedef struct shm_slot {
+    uint8_t size;
+    uint8_t data[MAX_PACKET_SIZE];
+} shm_slot_t;
+
+/**
+ * Single producer, single consumer packet ring.
+ * `head` is only written by the consumer and `tail` only by the producer, each on its own cache line.
+ */
+typedef struct shm_ring {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t head;
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t tail;
+
+    // Set by the consumer before it blocks on the ring's eventfd, so that the producer only signals when needed.
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t consumer_waiting;
+
+    _Alignas(CACHE_LINE_SIZE) shm_slot_t slots[SHM_RING_SLOTS];
+} shm_ring_t;
+
+// Layout of the shared memory region.
+typedef struct shm_link_region {
+    shm_ring_t to_app;
+    shm_ring_t to_router;
+} shm_link_region_t;
+
+// One end of the link (the application or the router).
+typedef struct shm_link {
+    int memfd;
+    shm_link_region_t *region;
+
+    shm_ring_t *tx;
+    shm_ring_t *rx;
+
+    // eventfds used to wake the consumer of the corresponding ring.
+    int tx_event;
+    int rx_event;
+
+    // The unix socket the link was handed over on. Nothing is sent on it afterwards,
+    // so it only becomes readable once the peer has gone. -1 if not kept.
+    int peer_sock;
+
+    // Several router threads may send to the application, the ring itself only has one producer slot.
+    pthread_mutex_t tx_lock;
+} shm_link_t;
+
+//=====================================
+//      FUNCTIONS
+//=====================================
+
+/**
+ * Makes `link` closed, so that `shm_link_close()` may be called on it whatever happens next.
+ */
+void shm_link_init(shm_link_t *link);
+
+/**
+ * Creates the shared memory region and eventfds (application side).
+ * Return Value - 0 on success, else -1.
+ */
+int shm_link_create(shm_link_t *link);
+
+/**
+ * Passes the shared memory and eventfds of a created link to the router over a connected unix socket.
+ * Return Value - 0 on success, else -1.
+ */
+int shm_link_share(const shm_link_t *link, const int sock);
+
+/**
+ * Receives and maps a link shared by the application over a connected unix socket (router side).
+ * Return Value - 0 on success, else -1.
+ */
+int shm_link_attach(shm_link_t *link, const int sock);
+
+/**
+ * Pushes a packet onto the outgoing ring, waiting for a free slot if the ring is full.
+ * Return Value - 0 if the packet was queued, -1 if the peer went away first.
+ */
+int shm_link_send(shm_link_t *link, const uint8_t *buf, const uint8_t size);
+
+/**
+ * Pops a packet from the incoming ring, blocking until one is available.
+ * Return Value - The size of the packet, or -1 on error or once the peer went away and the ring is empty.
+ */
+ssize_t shm_link_recv(shm_link_t *link, uint8_t *buf, const size_t size);
+
+/**
+ * Pops a packet from the incoming ring if one is available.
+ * Return Value - The size of the packet, or 0 if the ring is empty.
+ */
+ssize_t shm_link_try_recv(shm_link_t *link, uint8_t *buf, const size_t size);
+
+/**
+ * Unmaps the region and closes whichever file descriptors were opened.
+ */
+void shm_link_close(shm_link_t *link);
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef STATE_FILE_H
+#define STATE_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+//=====================================
+//      MACROS
+//=====================================
+
+#define STATE_FILE_MAGIC UINT32_C(0x52414E49)
+#define STATE_FILE_VERSION 1
+
+// Bounded by `CONFIG_MAX_LINK_COUNT`.
+#define STATE_FILE_MAX_LINK_COUNT 64
+
+//=====================================
+//      STRUCTURES
+//=====================================
+//
+//  State file format (host byte order, the file is only read back on the same machine):
+//  A `state_header_t`, followed by `entry_capacity` `state_entry_t` records.
+//  Record `i` mirrors entry `i` of the router's table, so updating an entry writes a single record.
+//
+
+typedef struct state_entry {
+    uint32_t prefix;
+    uint8_t is_valid;
+    uint8_t prefix_len;
+    uint8_t cost;
+    uint8_t next_hop_link;
+} state_entry_t;
+
+typedef struct state_header {
+    uint32_t magic;
+    uint32_t version;
+
+    // A file is only reloaded by a router with the same address and links.
+    uint8_t address;
+    uint8_t address_bits;
+    uint8_t link_count;
+    uint8_t link_weights[STATE_FILE_MAX_LINK_COUNT];
+
+    uint32_t entry_capacity;
+    // Records past this one have never been written.
+    uint32_t entry_end;
+
+    // Timestamp of the last command accepted on each link.
+    uint32_t link_timestamps[STATE_FILE_MAX_LINK_COUNT];
+} state_header_t;
+
+/**
+ * The state of a router, kept in a memory mapped file so it survives the router restarting.
+ * Updates are plain stores into the mapping; the kernel writes them back.
+ */
+typedef struct state_file {
+    int fd;
+    size_t size;
+    state_header_t *header;
+    state_entry_t *entries;
+} state_file_t;
+
+//=====================================
+//      FUNCTIONS
+//=====================================
+
+/**
+ * Maps the state file at `path`, creating it if needed.
+ * The file is kept if it was written by a router like `expected` (same address, address bits and links),
+ * otherwise it is cleared and given the header `expected`.
+ * `expected` - The header of the router, its `entry_end` and timestamps are ignored.
+ * Return Value - 1 if the file was kept, 0 if it was cleared, -1 on error.
+ */
+int state_file_open(state_file_t *file, const char *path, const state_header_t *expected);
+
+/**
+ * Writes the record of entry `index`.
+ */
+void state_file_set(state_file_t *file, const uint32_t index, const state_entry_t *entry);
+
+/**
+ * Clears every record, before the table is written again from scratch.
+ */
+void state_file_clear(state_file_t *file);
+
+/**
+ * Flushes and unmaps the file. Does nothing if it is not open.
+ */
+void state_file_close(state_file_t *file);
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../../include/common.h"
+
+//=====================================
+//      MACROS
+//=====================================
+
+#define STATS_MAGIC UINT32_C(0x52535453)
+#define STATS_VERSION 1
+
+#define STATS_CACHE_LINE_SIZE 64
+
+// Drop codes run from `PACKET_DROP_GENERAL` to `PACKET_DROP_DUPLICATE`, any other code is counted as general.
+#define STATS_DROP_CODE_FIRST PACKET_DROP_GENERAL
+#define STATS_DROP_CODE_COUNT (PACKET_DROP_DUPLICATE - PACKET_DROP_GENERAL + 1)
+
+// Shared memory segments are named `/<prefix><name>`, so a reader only needs the name from the config.
+#define STATS_SHM_PREFIX "rani_stats_"
+#define STATS_NAME_MAX 200
+
+//=====================================
+//      STRUCTURES
+//=====================================
+//
+//  Segment format (host byte order, only read on the same machine):
+//  A `stats_header_t`, followed by `thread_count` rows of `link_count + 1` `stats_counters_t`.
+//  Column `i` counts the packets of link `i`, the last column those of the application link.
+//  Each row is only written by its own thread, except the last, which is shared by threads without a row.
+//  A reader adds the rows up, and takes rates from the difference between two reads.
+//
+
+/**
+ * The counters of one thread for one link, alone on their cache lines so threads never write to the same line.
+ * Drops are counted against the link the dropping thread received its packet on.
+ */
+typedef struct stats_counters {
+    _Alignas(STATS_CACHE_LINE_SIZE) _Atomic uint64_t rx_packets;
+    _Atomic uint64_t rx_bytes;
+    _Atomic uint64_t tx_packets;
+    _Atomic uint64_t tx_bytes;
+    // Copies of distance vector advertisements sent by `send_buffer_to_links()`, also counted in `tx_packets`.
+    _Atomic uint64_t broadcasts;
+    _Atomic uint64_t drops[STATS_DROP_CODE_COUNT];
+} stats_counters_t;
+
+typedef struct stats_header {
+    uint32_t magic;
+    uint32_t version;
+    uint8_t address;
+    uint8_t link_count;
+    uint16_t thread_count;
+    // Set once the router is done, the segment is then removed.
+    _Atomic uint32_t is_closed;
+} stats_header_t;
+
+typedef struct stats {
+    int fd;
+    size_t size;
+    // Name of the shared memory segment, empty if the counters are not published.
+    char shm_name[sizeof(STATS_SHM_PREFIX) + STATS_NAME_MAX + 1];
+    stats_header_t *header;
+    stats_counters_t *counters;
+} stats_t;
+
+//=====================================
+//      FUNCTIONS
+//=====================================
+
+/**
+ * Allocates zeroed counters for `thread_count` rows of `link_count + 1` links.
+ * `name` - Publishes them in the shared memory segment of this name (See `STATS_SHM_PREFIX`),
+ *          replacing any segment left there. Empty to keep them private.
+ * Return Value - 0 on success, else -1.
+ */
+int stats_open(stats_t *stats, const char *name, const uint8_t address, const uint8_t link_count, const uint16_t thread_count);
+
+/**
+ * Marks the counters closed, and removes their segment. Does nothing if they are not open.
+ */
+void stats_close(stats_t *stats);
+
+/**
+ * Gives the calling thread its own row of `stats`.
+ * `link` - The link the thread receives packets on, which its drops are counted against.
+ */
+void stats_bind_thread(stats_t *stats, const uint16_t row, const uint8_t link);
+
+/**
+ * Count packets of `link`, in the row of the calling thread (or the shared row).
+ */
+void stats_count_rx(stats_t *stats, const uint8_t link, const uint32_t packets, const uint64_t bytes);
+
+void stats_count_tx(stats_t *stats, const uint8_t link, const uint32_t packets, const uint64_t bytes);
+
+void stats_count_broadcast(stats_t *stats, const uint8_t link, const uint64_t bytes);
+
+/**
+ * Counts a drop against the link of the calling thread (See `stats_bind_thread()`).
+ * Does nothing on threads without a row, such as those of the application.
+ */
+void stats_count_drop(const uint8_t drop_code);
+
+#endif
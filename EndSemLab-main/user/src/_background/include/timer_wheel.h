@@ -0,0 +1,77 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+#include "../../include/router_api.h"
+
+//=====================================
+//      MACROS
+//=====================================
+
+// Each level has 64 slots, each slot of a level spanning all 64 slots of the level below.
+// With 1 ms ticks, four levels reach about 4.6 hours ahead.
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_MAX_DELAY ((UINT64_C(1) << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOT_BITS)) - 1)
+
+//=====================================
+//      STRUCTURES
+//=====================================
+
+/**
+ * Hierarchical timer wheel. A timer lives in the slot of the lowest level whose span covers its delay,
+ * and moves down a level each time the wheel turns past the slot above it,
+ * so adding, removing and expiring a timer take constant time however many timers there are.
+ * Slots are circular lists of `router_timer_t`, headed by the slot itself.
+ */
+typedef struct timer_wheel {
+    // The last tick expired.
+    uint64_t now;
+    router_timer_t slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+} timer_wheel_t;
+
+//=====================================
+//      FUNCTIONS
+//=====================================
+
+/**
+ * `now` - The current tick.
+ */
+void timer_wheel_init(timer_wheel_t *wheel, const uint64_t now);
+
+/**
+ * Makes `list` an empty list of timers (See `timer_wheel_advance()`).
+ */
+void timer_list_init(router_timer_t *list);
+
+/**
+ * Adds a timer which is not pending.
+ * `expires` - The tick to expire at. Ticks already past expire on the next tick.
+ */
+void timer_wheel_add(timer_wheel_t *wheel, router_timer_t *timer, const uint64_t expires);
+
+/**
+ * Removes a pending timer from the wheel, or from the list of expired timers it was moved to.
+ */
+void timer_wheel_remove(router_timer_t *timer);
+
+static inline int timer_wheel_is_pending(const router_timer_t *timer) {
+    return timer->next != NULL;
+}
+
+/**
+ * The first tick after the last one expired at which turning the wheel does anything:
+ * expiring a slot of the lowest level, or spreading a slot of a higher level over the levels below.
+ * No timer expires before it, so the wheel may be left standing until then.
+ * Return Value - The tick, or `UINT64_MAX` if the wheel is empty.
+ */
+uint64_t timer_wheel_next_tick(const timer_wheel_t *wheel);
+
+/**
+ * Turns the wheel up to `now`, moving the timers that expire on the way to the end of `expired`.
+ * Return Value - The number of timers moved.
+ */
+uint32_t timer_wheel_advance(timer_wheel_t *wheel, const uint64_t now, router_timer_t *expired);
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "../../include/packet.h"
+
+//=====================================
+//      MACROS
+//=====================================
+
+// Environment variable selecting the router <-> application transport by name ("tcp" (default), "unix" or "shm").
+#define APP_LINK_ENV "RANI_APP_LINK"
+
+// Address the application listens on for each transport.
+#define APP_TCP_ADDRESS "127.0.0.1:5000"
+#define APP_SOCKET_PATH "/tmp/rani_app.sock"
+#define APP_SHM_SOCKET_PATH "/tmp/rani_app_link.sock"
+
+// When the network simulation address is a directory instead of an IP address,
+// link `n` is the unix socket `<directory>/link<n>`.
+#define NETSIM_SOCKET_FORMAT "%s/link%d"
+
+// Longest a connecting `open()` waits for its peer to answer.
+#define TRANSPORT_CONNECT_TIMEOUT_MS 1000
+
+// Maximum number of packets moved by one `recv_batch()` call of the drivers.
+#define TRANSPORT_BATCH_MAX 32
+
+//=====================================
+//      STRUCTURES
+//=====================================
+
+typedef enum transport_role {
+    // Connect to the address, then send the hello byte.
+    TRANSPORT_CONNECT,
+    // Wait for one peer at the address, then expect the hello byte from it.
+    TRANSPORT_ACCEPT,
+} transport_role_t;
+
+/**
+ * One packet of a batch.
+ * For receiving, `buf` must have room for `MAX_PACKET_SIZE` bytes and `size` is filled in.
+ */
+typedef struct transport_msg {
+    uint8_t *buf;
+    uint8_t size;
+} transport_msg_t;
+
+typedef struct transport transport_t;
+
+/**
+ * Operations every transport implements.
+ * Packet boundaries are preserved: each message sent is received as exactly one message.
+ */
+typedef struct transport_ops {
+    const char *name;
+
+    /**
+     * Opens the transport. The format of `address` depends on the transport.
+     * `hello` - The byte identifying the link, sent by the connecting side and checked by the accepting side.
+     * Return Value - 0 on success, else -1.
+     */
+    int (*open)(transport_t *transport, const char *address, const transport_role_t role, const uint8_t hello);
+
+    /**
+     * Receives up to `count` packets, blocking until at least one is available.
+     * Return Value - The number of packets received, 0 if the peer closed the link, or -1 on error.
+     */
+    int (*recv_batch)(transport_t *transport, transport_msg_t *msgs, const int count);
+
+    /**
+     * Sends `count` packets in order.
+     * Return Value - The number of packets sent, or -1 on error.
+     */
+    int (*send_batch)(transport_t *transport, const transport_msg_t *msgs, const int count);
+
+    void (*close)(transport_t *transport);
+} transport_ops_t;
+
+struct transport {
+    const transport_ops_t *ops;
+    int fd;
+    void *state;
+};
+
+//=====================================
+//      TRANSPORTS
+//=====================================
+
+// Address "<ipv4>:<port>". Packets are framed on the stream by their length field.
+extern const transport_ops_t transport_tcp;
+
+// Address is the path of a unix `SOCK_SEQPACKET` socket.
+extern const transport_ops_t transport_unix;
+
+// Address is the path of the unix socket used to hand the shared memory rings over.
+extern const transport_ops_t transport_shm;
+
+//=====================================
+//      FUNCTIONS
+//=====================================
+
+/**
+ * Return Value - The transport called `name`, or NULL if there is none.
+ */
+const transport_ops_t *transport_find(const char *name);
+
+/**
+ * Opens `transport` with the given operations (See `transport_ops_t.open`).
+ */
+int transport_open(transport_t *transport, const transport_ops_t *ops, const char *address, const transport_role_t role, const uint8_t hello);
+
+/**
+ * Sends a single packet.
+ * Return Value - 0 if the packet was sent properly, else -1.
+ */
+int transport_send(transport_t *transport, const uint8_t *buf, const uint8_t size);
+
+/**
+ * Receives a single packet into `buf` (which must have room for `MAX_PACKET_SIZE` bytes).
+ * Return Value - The size of the packet, 0 if the peer closed the link, or -1 on error.
+ */
+ssize_t transport_recv(transport_t *transport, uint8_t *buf);
+
+void transport_close(transport_t *transport);
+
+// Shared by the socket based transports.
+int transport_unix_open(transport_t *transport, const char *address, const transport_role_t role, const uint8_t hello);
+int transport_socket_send_batch(transport_t *transport, const transport_msg_t *msgs, const int count);
+void transport_socket_close(transport_t *transport);
+
+#endif
@@ -0,0 +1,239 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/lpm.h"
+
+//=====================================
+//      CONSTANTS
+//=====================================
+
+#define RULE_EMPTY UINT32_MAX
+#define RULE_DELETED (UINT32_MAX - 1)
+#define RULE_INITIAL_CAPACITY 64
+
+#define L2_INITIAL_GROUPS 4
+
+//=====================================
+//      HELPERS
+//=====================================
+
+static inline uint32_t entry_leaf(const uint8_t depth, const uint32_t route) {
+    return LPM_ENTRY_VALID | ((uint32_t) depth << 24) | route;
+}
+
+static inline uint8_t entry_depth(const uint32_t entry) {
+    return (entry >> 24) & 0x3F;
+}
+
+static inline uint32_t prefix_mask(const lpm_table_t *table, const uint8_t prefix_len) {
+    if(prefix_len == 0) return 0;
+    const uint32_t address_mask = (UINT32_C(1) << table->address_bits) - 1;
+    return (address_mask << (table->address_bits - prefix_len)) & address_mask;
+}
+
+static inline uint32_t rule_key(const uint32_t prefix, const uint8_t prefix_len) {
+    return ((uint32_t) prefix_len << 24) | prefix;
+}
+
+static inline uint32_t rule_slot(const lpm_table_t *table, const uint32_t key) {
+    const int shift = 32 - __builtin_ctz(table->rule_capacity);
+    return (key * UINT32_C(0x9E3779B1)) >> shift;
+}
+
+/**
+ * Return Value - The slot holding `key`, or `table->rule_capacity` if there is none.
+ */
+static uint32_t rule_get(const lpm_table_t *table, const uint32_t key) {
+    const uint32_t mask = table->rule_capacity - 1;
+    for(uint32_t slot = rule_slot(table, key); table->rule_keys[slot] != RULE_EMPTY; slot = (slot + 1) & mask) {
+        if(table->rule_keys[slot] == key) return slot;
+    }
+    return table->rule_capacity;
+}
+
+static int rule_table_alloc(lpm_table_t *table, const uint32_t capacity) {
+    table->rule_keys = malloc(sizeof(uint32_t) * capacity);
+    table->rule_routes = malloc(sizeof(uint32_t) * capacity);
+    if(!table->rule_keys || !table->rule_routes) return -1;
+
+    memset(table->rule_keys, 0xFF, sizeof(uint32_t) * capacity);
+    table->rule_capacity = capacity;
+    table->rule_used = 0;
+    return 0;
+}
+
+static int rule_put(lpm_table_t *table, const uint32_t key, const uint32_t route);
+
+static int rule_grow(lpm_table_t *table) {
+    uint32_t *keys = table->rule_keys;
+    uint32_t *routes = table->rule_routes;
+    const uint32_t capacity = table->rule_capacity;
+
+    if(rule_table_alloc(table, capacity * 2) != 0) return -1;
+    for(uint32_t i = 0; i < capacity; i++) {
+        if(keys[i] < RULE_DELETED) rule_put(table, keys[i], routes[i]);
+    }
+
+    free(keys);
+    free(routes);
+    return 0;
+}
+
+static int rule_put(lpm_table_t *table, const uint32_t key, const uint32_t route) {
+    const uint32_t existing = rule_get(table, key);
+    if(existing != table->rule_capacity) {
+        table->rule_routes[existing] = route;
+        return 0;
+    }
+
+    // Deleted slots count as used, so probe sequences always end at an empty slot.
+    if((table->rule_used + 1) * 4 > table->rule_capacity * 3 && rule_grow(table) != 0) return -1;
+
+    const uint32_t mask = table->rule_capacity - 1;
+    uint32_t slot = rule_slot(table, key);
+    while(table->rule_keys[slot] < RULE_DELETED) slot = (slot + 1) & mask;
+
+    if(table->rule_keys[slot] == RULE_EMPTY) table->rule_used += 1;
+    table->rule_keys[slot] = key;
+    table->rule_routes[slot] = route;
+    return 0;
+}
+
+/**
+ * Return Value - The index of a new second level group, filled with `entry`, or -1.
+ */
+static int64_t group_alloc(lpm_table_t *table, const uint32_t entry) {
+    if(table->l2_group_count == table->l2_group_capacity) {
+        const uint32_t capacity = table->l2_group_capacity ? table->l2_group_capacity * 2 : L2_INITIAL_GROUPS;
+        uint32_t *l2 = realloc(table->l2, sizeof(uint32_t) * ((size_t) capacity << table->l2_bits));
+        if(!l2) return -1;
+
+        table->l2 = l2;
+        table->l2_group_capacity = capacity;
+    }
+
+    const uint32_t group = table->l2_group_count++;
+    uint32_t *entries = &table->l2[(size_t) group << table->l2_bits];
+    for(uint32_t i = 0; i < (UINT32_C(1) << table->l2_bits); i++) {
+        entries[i] = entry;
+    }
+    return group;
+}
+
+/**
+ * Writes `entry` over `count` entries from `entries`.
+ * When adding, only entries set by prefixes no longer than `depth` are written, keeping longer prefixes in place.
+ * When deleting, only entries set by the deleted prefix itself (of length `depth`) are written.
+ */
+static void entries_write(uint32_t *entries, const uint32_t count, const uint32_t entry, const uint8_t depth, const int is_delete) {
+    for(uint32_t i = 0; i < count; i++) {
+        const uint32_t current = entries[i];
+        const int is_valid = (current & LPM_ENTRY_VALID) != 0;
+
+        if(is_delete ? (is_valid && entry_depth(current) == depth) : (!is_valid || entry_depth(current) <= depth)) {
+            entries[i] = entry;
+        }
+    }
+}
+
+static int table_write(lpm_table_t *table, const uint32_t prefix, const uint8_t prefix_len, const uint32_t entry, const int is_delete) {
+    const uint32_t l2_size = UINT32_C(1) << table->l2_bits;
+
+    if(prefix_len <= table->l1_bits) {
+        const uint32_t first = prefix >> table->l2_bits;
+        const uint32_t count = UINT32_C(1) << (table->l1_bits - prefix_len);
+
+        for(uint32_t i = first; i < first + count; i++) {
+            if(table->l1[i] & LPM_ENTRY_EXTENDED) {
+                uint32_t *group = &table->l2[(size_t) LPM_ENTRY_ROUTE(table->l1[i]) << table->l2_bits];
+                entries_write(group, l2_size, entry, prefix_len, is_delete);
+            }
+            else {
+                entries_write(&table->l1[i], 1, entry, prefix_len, is_delete);
+            }
+        }
+        return 0;
+    }
+
+    // The prefix ends inside a second level group.
+    uint32_t *l1_entry = &table->l1[prefix >> table->l2_bits];
+    if(!(*l1_entry & LPM_ENTRY_EXTENDED)) {
+        if(is_delete) return 0;
+
+        const int64_t group = group_alloc(table, *l1_entry);
+        if(group < 0) return -1;
+        *l1_entry = LPM_ENTRY_VALID | LPM_ENTRY_EXTENDED | (uint32_t) group;
+    }
+
+    uint32_t *group = &table->l2[(size_t) LPM_ENTRY_ROUTE(*l1_entry) << table->l2_bits];
+    const uint32_t first = prefix & (l2_size - 1);
+    const uint32_t count = UINT32_C(1) << (table->address_bits - prefix_len);
+    entries_write(&group[first], count, entry, prefix_len, is_delete);
+    return 0;
+}
+
+//=====================================
+//      FUNCTIONS
+//=====================================
+
+int lpm_init(lpm_table_t *table, const uint8_t address_bits) {
+    memset(table, 0, sizeof(*table));
+    if(address_bits == 0 || address_bits > LPM_MAX_ADDRESS_BITS) return -1;
+
+    table->address_bits = address_bits;
+    table->l1_bits = address_bits < LPM_L1_MAX_BITS ? address_bits : LPM_L1_MAX_BITS;
+    table->l2_bits = address_bits - table->l1_bits;
+
+    table->l1 = calloc(UINT32_C(1) << table->l1_bits, sizeof(uint32_t));
+    if(!table->l1 || rule_table_alloc(table, RULE_INITIAL_CAPACITY) != 0) {
+        lpm_free(table);
+        return -1;
+    }
+
+    return 0;
+}
+
+void lpm_free(lpm_table_t *table) {
+    free(table->l1);
+    free(table->l2);
+    free(table->rule_keys);
+    free(table->rule_routes);
+    memset(table, 0, sizeof(*table));
+}
+
+int lpm_add(lpm_table_t *table, uint32_t prefix, const uint8_t prefix_len, const uint32_t route) {
+    if(prefix_len > table->address_bits || route > LPM_MAX_ROUTE) return -1;
+    prefix &= prefix_mask(table, prefix_len);
+
+    if(rule_put(table, rule_key(prefix, prefix_len), route) != 0) return -1;
+    return table_write(table, prefix, prefix_len, entry_leaf(prefix_len, route), 0);
+}
+
+int lpm_delete(lpm_table_t *table, uint32_t prefix, const uint8_t prefix_len) {
+    if(prefix_len > table->address_bits) return -1;
+    prefix &= prefix_mask(table, prefix_len);
+
+    const uint32_t slot = rule_get(table, rule_key(prefix, prefix_len));
+    if(slot == table->rule_capacity) return -1;
+    table->rule_keys[slot] = RULE_DELETED;
+
+    // Fall back to the longest shorter prefix covering this one, if any.
+    uint32_t replacement = 0;
+    for(int len = prefix_len - 1; len >= 0; len--) {
+        const uint32_t route = lpm_find(table, prefix, len);
+        if(route != LPM_NO_ROUTE) {
+            replacement = entry_leaf(len, route);
+            break;
+        }
+    }
+
+    return table_write(table, prefix, prefix_len, replacement, 1);
+}
+
+uint32_t lpm_find(const lpm_table_t *table, uint32_t prefix, const uint8_t prefix_len) {
+    if(prefix_len > table->address_bits) return LPM_NO_ROUTE;
+    prefix &= prefix_mask(table, prefix_len);
+
+    const uint32_t slot = rule_get(table, rule_key(prefix, prefix_len));
+    return slot == table->rule_capacity ? LPM_NO_ROUTE : table->rule_routes[slot];
+}
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "../include/common.h"
+#include "include/lpm.h"
+
+#define ANSI_COLOR_RED     "\x1b[31m"
+#define ANSI_COLOR_GREEN   "\x1b[32m"
+#define ANSI_COLOR_RESET   "\x1b[0m"
+
+//=====================================
+//      DATA
+//=====================================
+
+// Prefixes of the brute force reference, added and deleted at random.
+#define TEST_RULE_COUNT 48
+#define TEST_OPERATION_COUNT 400
+
+// Both sides of `LPM_L1_MAX_BITS`, so that tables with and without second level groups are covered.
+// Lookups are checked for every address up to `TEST_EXHAUSTIVE_BITS`, and around the bounds of every prefix above it.
+static const uint8_t TEST_ADDRESS_BITS[] = { 1, 6, 12, 16, 17, 20, 24 };
+#define TEST_EXHAUSTIVE_BITS 12
+
+typedef struct test_rule {
+    uint32_t prefix;
+    uint8_t prefix_len;
+    uint32_t route;
+    uint8_t is_added;
+} test_rule_t;
+
+static int current_test_case, net_assertion;
+static uint32_t random_state;
+
+//=====================================
+//      FUNCTIONS
+//=====================================
+
+static inline void test_case(const int assertion, const char *msg) {
+    print(
+        "[*] Longest Prefix Match Test %d [%s]: %s\n",
+        current_test_case,
+        msg,
+        assertion ? ANSI_COLOR_GREEN "PASSED" ANSI_COLOR_RESET : ANSI_COLOR_RED "FAILED" ANSI_COLOR_RESET
+    );
+    net_assertion = net_assertion && assertion;
+    current_test_case += 1;
+}
+
+// Deterministic, so a failure can be replayed.
+static uint32_t test_random(void) {
+    random_state = random_state * UINT32_C(1664525) + UINT32_C(1013904223);
+    return random_state >> 8;
+}
+
+static uint32_t test_mask(const uint8_t address_bits, const uint8_t prefix_len) {
+    if(prefix_len == 0) return 0;
+    const uint32_t address_mask = (UINT32_C(1) << address_bits) - 1;
+    return (address_mask << (address_bits - prefix_len)) & address_mask;
+}
+
+// The route of the longest added rule containing `address`, found by trying every rule.
+static uint32_t reference_lookup(const test_rule_t *rules, const uint8_t address_bits, const uint32_t address) {
+    int best = -1;
+    for(int i = 0; i < TEST_RULE_COUNT; i++) {
+        const test_rule_t *rule = &rules[i];
+        if(!rule->is_added || (address & test_mask(address_bits, rule->prefix_len)) != rule->prefix) continue;
+        if(best < 0 || rule->prefix_len > rules[best].prefix_len) best = i;
+    }
+    return best < 0 ? LPM_NO_ROUTE : rules[best].route;
+}
+
+static int lookups_match(const lpm_table_t *table, const test_rule_t *rules, const uint8_t address_bits) {
+    const uint32_t address_count = UINT32_C(1) << address_bits;
+    if(address_bits <= TEST_EXHAUSTIVE_BITS) {
+        for(uint32_t address = 0; address < address_count; address++) {
+            if(lpm_lookup(table, address) != reference_lookup(rules, address_bits, address)) return 0;
+        }
+        return 1;
+    }
+
+    // Routes only change at the bounds of prefixes, so the addresses on either side of each bound cover every range.
+    for(int i = 0; i < TEST_RULE_COUNT; i++) {
+        if(rules[i].prefix_len == 0xFF) continue;
+        const uint32_t first = rules[i].prefix;
+        const uint32_t last = first | (~test_mask(address_bits, rules[i].prefix_len) & (address_count - 1));
+        const uint32_t addresses[] = { first, first - 1, last, last + 1 };
+        for(size_t j = 0; j < sizeof(addresses) / sizeof(addresses[0]); j++) {
+            const uint32_t address = addresses[j] & (address_count - 1);
+            if(lpm_lookup(table, address) != reference_lookup(rules, address_bits, address)) return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Adds and deletes random prefixes (nested ones included), checking every lookup against the reference after each change.
+ */
+static int random_operations_match(const uint8_t address_bits) {
+    lpm_table_t table;
+    if(lpm_init(&table, address_bits) != 0) return 0;
+
+    // Prefixes are drawn around a few addresses, so that many of them nest.
+    test_rule_t rules[TEST_RULE_COUNT];
+    const uint32_t address_mask = (UINT32_C(1) << address_bits) - 1;
+    uint32_t centres[3];
+    for(int i = 0; i < 3; i++) {
+        centres[i] = test_random() & address_mask;
+    }
+    for(int i = 0; i < TEST_RULE_COUNT; i++) {
+        rules[i].prefix_len = test_random() % (address_bits + 1);
+        rules[i].prefix = centres[i % 3] & test_mask(address_bits, rules[i].prefix_len);
+        rules[i].route = i;
+        rules[i].is_added = 0;
+        // Rules for the same prefix would shadow each other, keep the first.
+        for(int j = 0; j < i; j++) {
+            if(rules[j].prefix == rules[i].prefix && rules[j].prefix_len == rules[i].prefix_len) rules[i].prefix_len = 0xFF;
+        }
+    }
+
+    int is_ok = 1;
+    for(int operation = 0; operation < TEST_OPERATION_COUNT && is_ok; operation++) {
+        test_rule_t *rule = &rules[test_random() % TEST_RULE_COUNT];
+        if(rule->prefix_len == 0xFF) continue;
+
+        if(rule->is_added && test_random() % 2) {
+            is_ok = lpm_delete(&table, rule->prefix, rule->prefix_len) == 0;
+            rule->is_added = 0;
+        }
+        else {
+            // Re-adding a prefix changes its route.
+            rule->route = (rule->route + TEST_RULE_COUNT) & LPM_MAX_ROUTE;
+            is_ok = lpm_add(&table, rule->prefix, rule->prefix_len, rule->route) == 0;
+            rule->is_added = 1;
+        }
+
+        for(int i = 0; i < TEST_RULE_COUNT && is_ok; i++) {
+            if(rules[i].prefix_len == 0xFF) continue;
+            const uint32_t route = lpm_find(&table, rules[i].prefix, rules[i].prefix_len);
+            is_ok = route == (rules[i].is_added ? rules[i].route : LPM_NO_ROUTE);
+        }
+        is_ok = is_ok && lookups_match(&table, rules, address_bits);
+    }
+
+    lpm_free(&table);
+    return is_ok;
+}
+
+// Returns 1 if all tests pass, else 0.
+int test_lpm(void) {
+    lpm_table_t table;
+    current_test_case = 1;
+    net_assertion = 1;
+    random_state = 1;
+    int retval;
+
+    test_case(lpm_init(&table, 0) == -1 && lpm_init(&table, LPM_MAX_ADDRESS_BITS + 1) == -1, "invalid address bits");
+
+    retval = lpm_init(&table, 6);
+    test_case(retval == 0 && lpm_lookup(&table, 12) == LPM_NO_ROUTE && lpm_delete(&table, 12, 6) == -1, "empty table");
+
+    retval = lpm_add(&table, 0x20, 1, 1) | lpm_add(&table, 0x30, 2, 2) | lpm_add(&table, 0x34, 6, 3);
+    test_case(retval == 0 && lpm_lookup(&table, 0x34) == 3 && lpm_lookup(&table, 0x35) == 2 &&
+        lpm_lookup(&table, 0x20) == 1 && lpm_lookup(&table, 0x1F) == LPM_NO_ROUTE, "nested prefix add");
+
+    retval = lpm_delete(&table, 0x30, 2);
+    test_case(retval == 0 && lpm_lookup(&table, 0x35) == 1 && lpm_lookup(&table, 0x34) == 3 &&
+        lpm_find(&table, 0x30, 2) == LPM_NO_ROUTE, "delete falls back to covering prefix");
+    lpm_free(&table);
+
+    // 20 bits: 16 resolved by the first level, the last 4 by second level groups.
+    retval = lpm_init(&table, 20);
+    retval |= lpm_add(&table, 0xAB000, 8, 1) | lpm_add(&table, 0xABCD8, 17, 2) | lpm_add(&table, 0xABCDE, 20, 3);
+    test_case(retval == 0 && lpm_lookup(&table, 0xABCDE) == 3 && lpm_lookup(&table, 0xABCDF) == 2 &&
+        lpm_lookup(&table, 0xABCD7) == 1 && lpm_lookup(&table, 0xAC000) == LPM_NO_ROUTE, "prefixes split into second level");
+
+    retval = lpm_add(&table, 0xABC00, 12, 4);
+    test_case(retval == 0 && lpm_lookup(&table, 0xABCDF) == 2 && lpm_lookup(&table, 0xABCD7) == 4 &&
+        lpm_lookup(&table, 0xAB000) == 1, "shorter prefix keeps longer ones in second level");
+
+    retval = lpm_delete(&table, 0xABCD8, 17) | lpm_delete(&table, 0xABC00, 12);
+    test_case(retval == 0 && lpm_lookup(&table, 0xABCDF) == 1 && lpm_lookup(&table, 0xABCDE) == 3,
+        "second level delete falls back to covering prefix");
+    lpm_free(&table);
+
+    for(size_t i = 0; i < sizeof(TEST_ADDRESS_BITS) / sizeof(TEST_ADDRESS_BITS[0]); i++) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "random adds and deletes, %u address bits", TEST_ADDRESS_BITS[i]);
+        test_case(random_operations_match(TEST_ADDRESS_BITS[i]), msg);
+    }
+
+    return net_assertion;
+}
@@ -21,13 +21,41 @@ static const packet_t TEST_PKT_1 = { 19, 65, 17, 6, 1, PACKET_TYPE_DATA, 3348,
 
 static const uint8_t TEST_BUF_2[] = { 103, 7, 18, 15, 65, 11, 195, 0, 3, 13, 187, 160, 16, 45, 1, 100, 78, 3 };
 static const packet_t TEST_PKT_2 = { 103, 7, 18, 15, 0, PACKET_TYPE_COMMAND, 267,
-    { .cmd = { 3, 900000, {
+    { .cmd = { 3, 0, 0, 900000, {
         { 16, 45 },
         { 1, 100 },
         { 78, 3 }
     } } } 
 };
 
+static const uint8_t TEST_BUF_3[] = { 103, 7, 18, 15, 65, 11, 147, 0, 3, 61, 187, 160, 16, 45, 1, 100, 78, 3 };
+static const packet_t TEST_PKT_3 = { 103, 7, 18, 15, 0, PACKET_TYPE_COMMAND, 267,
+    { .cmd = { 3, 1, 1, 900000, {
+        { 16, 45 },
+        { 1, 100 },
+        { 78, 3 }
+    } } } 
+};
+
+static const uint8_t TEST_BUF_4[] = { 12, 8, 14, 1, 32, 0, 14, 0, 3, 1, 0, 100, 18, 52 };
+static const packet_t TEST_PKT_4 = { 12, 8, 14, 1, 0, PACKET_TYPE_HELLO, 0,
+    { .hello = { 3, 1, 100, 4660 } }
+};
+
+// A hello asking for no reply (timestamp 0), and a reply echoing a timestamp with its high byte set.
+static const uint8_t TEST_BUF_5[] = { 20, 12, 14, 1, 32, 0, 191, 0, 5, 0, 3, 232, 0, 0 };
+static const packet_t TEST_PKT_5 = { 20, 12, 14, 1, 0, PACKET_TYPE_HELLO, 0,
+    { .hello = { 5, 0, 1000, 0 } }
+};
+
+static const uint8_t TEST_BUF_6[] = { 12, 20, 14, 1, 32, 0, 73, 0, 3, 1, 0, 100, 255, 254 };
+static const packet_t TEST_PKT_6 = { 12, 20, 14, 1, 0, PACKET_TYPE_HELLO, 0,
+    { .hello = { 3, 1, 100, 65534 } }
+};
+
+// Too short for a hello payload.
+static const uint8_t TEST_BUF_HELLO_SHORT[] = { 20, 12, 12, 1, 32, 0, 193, 0, 5, 0, 3, 232 };
+
 static int current_test_case, net_assertion;
 
 //=====================================
@@ -48,11 +76,15 @@ static int packet_eq(const packet_t *a, const packet_t *b) {
 
     if(a->type == PACKET_TYPE_DATA) {
         return memcmp(a->payload_as.data, b->payload_as.data, a->length - HEADER_SIZE) == 0;
+    } else if(a->type == PACKET_TYPE_HELLO) {
+        const hello_payload_t *x = &a->payload_as.hello, *y = &b->payload_as.hello;
+        return x->multiplier == y->multiplier && x->flag_reply == y->flag_reply &&
+            x->interval_ms == y->interval_ms && x->timestamp_ms == y->timestamp_ms;
     } else {
         const cmd_payload_t *ac = &a->payload_as.cmd;
         const cmd_payload_t *bc = &b->payload_as.cmd;
 
-        eq = ac->entry_count == bc->entry_count && ac->timestamp == bc->timestamp;
+        eq = ac->entry_count == bc->entry_count && ac->flag_delta == bc->flag_delta && ac->flag_more == bc->flag_more && ac->timestamp == bc->timestamp;
         if(!eq) return 0;
 
         for(int i = 0; i < ac->entry_count; i++) {
@@ -101,5 +133,31 @@ int test_packet_parsing(void) {
     retval = packet_deserialise(&pkt, TEST_BUF_2, sizeof(TEST_BUF_2));
     test_case(retval == 0 && packet_eq(&pkt, &TEST_PKT_2), "cmd packet deserialise");
 
+    retval = packet_serialise(&TEST_PKT_3, buf, sizeof(buf));
+    test_case(retval == 0 && memcmp(buf, TEST_BUF_3, TEST_PKT_3.length) == 0, "flagged cmd packet serialise");
+
+    retval = packet_deserialise(&pkt, TEST_BUF_3, sizeof(TEST_BUF_3));
+    test_case(retval == 0 && packet_eq(&pkt, &TEST_PKT_3), "flagged cmd packet deserialise");
+
+    retval = packet_serialise(&TEST_PKT_4, buf, sizeof(buf));
+    test_case(retval == 0 && memcmp(buf, TEST_BUF_4, TEST_PKT_4.length) == 0, "hello packet serialise");
+
+    retval = packet_deserialise(&pkt, TEST_BUF_4, sizeof(TEST_BUF_4));
+    test_case(retval == 0 && packet_eq(&pkt, &TEST_PKT_4), "hello packet deserialise");
+
+    retval = packet_serialise(&TEST_PKT_5, buf, sizeof(buf));
+    test_case(retval == 0 && memcmp(buf, TEST_BUF_5, TEST_PKT_5.length) == 0, "hello request serialise");
+
+    retval = packet_deserialise(&pkt, TEST_BUF_5, sizeof(TEST_BUF_5));
+    test_case(retval == 0 && packet_eq(&pkt, &TEST_PKT_5), "hello request deserialise");
+
+    retval = packet_serialise(&TEST_PKT_6, buf, sizeof(buf));
+    test_case(retval == 0 && memcmp(buf, TEST_BUF_6, TEST_PKT_6.length) == 0, "hello reply serialise");
+
+    retval = packet_deserialise(&pkt, TEST_BUF_6, sizeof(TEST_BUF_6));
+    test_case(retval == 0 && packet_eq(&pkt, &TEST_PKT_6), "hello reply deserialise");
+
+    test_case(packet_deserialise(&pkt, TEST_BUF_HELLO_SHORT, sizeof(TEST_BUF_HELLO_SHORT)) == -1, "short hello deserialise");
+
     return net_assertion;
 }
\ No newline at end of file
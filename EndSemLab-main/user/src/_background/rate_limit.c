@@ -0,0 +1,38 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+#include "include/rate_limit.h"
+
+//=====================================
+//      CONSTANTS
+//=====================================
+
+#define NS_PER_SEC UINT64_C(1000000000)
+
+//=====================================
+//      FUNCTIONS
+//=====================================
+
+uint64_t rate_limit_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * NS_PER_SEC + now.tv_nsec;
+}
+
+int token_bucket_take(token_bucket_t *bucket, const rate_limit_t *limit, const uint64_t now_ns) {
+    if(limit->rate == 0) return 1;
+
+    const uint64_t token_ns = NS_PER_SEC / limit->rate;
+    const uint64_t burst_ns = token_ns * (limit->burst ? limit->burst : 1);
+
+    uint64_t full_at = atomic_load_explicit(&bucket->full_at_ns, memory_order_relaxed);
+    while(1) {
+        // A bucket that has been full for a while holds no more than `burst` tokens.
+        const uint64_t start = full_at > now_ns ? full_at : now_ns;
+        if(start + token_ns - now_ns > burst_ns) return 0;
+
+        if(atomic_compare_exchange_weak_explicit(&bucket->full_at_ns, &full_at, start + token_ns, memory_order_relaxed, memory_order_relaxed)) {
+            return 1;
+        }
+    }
+}
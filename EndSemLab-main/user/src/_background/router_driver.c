@@ -4,14 +4,25 @@
 #include <stdlib.h>
 #include <arpa/inet.h>
 #include <string.h>
+#include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 #include "../include/common.h"
 #include "../include/packet.h"
 #include "../include/router_api.h"
+#include "include/config.h"
 #include "include/log.h"
+#include "include/lpm.h"
+#include "include/rate_limit.h"
+#include "include/state_file.h"
+#include "include/stats.h"
+#include "include/timer_wheel.h"
+#include "include/transport.h"
 
 #define ANSI_COLOR_RED     "\x1b[31m"
 #define ANSI_COLOR_GREEN   "\x1b[32m"
@@ -27,146 +38,740 @@
 //      CONSTANTS
 //=====================================
 
-#define ERROR_VALUE 0xFF
-
-#define NETSIM_LINK_COUNT 4
-#define TOTAL_LINK_COUNT (NETSIM_LINK_COUNT + 1)
-
-#define APP_LINK (TOTAL_LINK_COUNT - 1)
-#define NETSIM_LINK_BEGIN 0
-#define NETSIM_LINK_END (TOTAL_LINK_COUNT - 2)
+// The application link comes after the links to the network simulation.
+#define APP_LINK(router) ((router)->link_count)
 
 #define BASE_LINK_PORT 10000
-#define APP_PORT 5000
 #define APP_INITIAL_BYTE 5
 #define ERROR_PORT 22222
 
+// Link threads only need a few kilobytes of stack, the default of several megabytes
+// dominates the memory of a process hosting many routers.
+#define LINK_THREAD_STACK_SIZE (256 * 1024)
+
+// A router may try to reach the application while it is still accepting the previous router.
+#define APP_CONNECT_ATTEMPTS 100
+#define APP_CONNECT_RETRY_US 10000
+
+// Links to the network simulation are opened by their own threads, all at once.
+// A link that fails (or whose peer closes it) is retried with exponential backoff, and given up after the last attempt.
+#define LINK_CONNECT_ATTEMPTS 20
+#define LINK_RETRY_MIN_US 10000
+#define LINK_RETRY_MAX_US 1000000
+#define LINK_ADDRESS_MAX 256
+
+// Rows of the counters (See `stats.h`): one per link thread, the application link's last,
+// then the timer thread's, then one shared by any other thread.
+#define STATS_TIMER_ROW(router) ((router)->link_count + 1)
+#define STATS_ROW_COUNT(router) ((router)->link_count + 3)
+
+// Timers tick once a millisecond.
+#define TIMER_TICK_NS 1000000L
+
 #define SUBNET_MASK_BITS 6
-#define SUBNET_ADDRESS_MAX (1 << SUBNET_MASK_BITS)
 #define SUBNET(addr) ((addr & 0xFC) >> 2)
 
-#define MY_ADDR 12
-#define APP_ADDR 14
+// DV entries are allocated in chunks, so entries never move once handed out by `dv_get_entry()`.
+// A chunk has as many entries as a validity word has bits.
+#define DV_CHUNK_BITS 6
+#define DV_CHUNK_SIZE (1 << DV_CHUNK_BITS)
+#define DV_SLOT(index) ((index) & (DV_CHUNK_SIZE - 1))
+#define DV_NO_ENTRY UINT32_MAX
+
+// Topology of the lab, used when no config file is given.
+// The network simulation address is filled in from the command line.
+#define DEFAULT_CONFIG_FORMAT \
+    "router\n" \
+    "netsim %s\n" \
+    "address 12\n" \
+    "app_address 14\n" \
+    "link 2 2\n" \
+    "link 5 3\n" \
+    "link 18 2\n" \
+    "link 45 11\n"
 
 //=====================================
 //      STRUCTURES
 //=====================================
 
-typedef struct dv_entry_wrapper {
-    uint8_t is_valid;
-    uint8_t dest_subnet;
-    dv_entry_t entry;
-} dv_entry_wrapper_t ;
+/**
+ * `DV_CHUNK_SIZE` consecutive entries of the table. Costs and next hops are kept apart from the prefixes,
+ * so walking the entries of a chunk reads two cache lines.
+ */
+typedef struct dv_chunk {
+    dv_entry_t entries[DV_CHUNK_SIZE];
+    uint8_t prefix_lens[DV_CHUNK_SIZE];
+    // Index of the next free entry instead, while the entry is not valid and on the free list.
+    uint32_t prefixes[DV_CHUNK_SIZE];
+} dv_chunk_t;
 
 typedef struct router_data {
-    uint8_t link_weights[NETSIM_LINK_COUNT];
-
-    // Addr[7:2] (subnet) used to index.
-    uint8_t dv_entry_count;
-    dv_entry_wrapper_t dv[SUBNET_ADDRESS_MAX];
+    // Width of destination subnets, `SUBNET_MASK_BITS` unless the config asks for more.
+    uint8_t address_bits;
+
+    // Longest prefix match from a destination to the index of its entry.
+    lpm_table_t lpm;
+
+    // Entry `i` is `dv_chunks[i >> DV_CHUNK_BITS]->entries[i % DV_CHUNK_SIZE]`,
+    // and is valid if bit `i % DV_CHUNK_SIZE` of `dv_valid[i >> DV_CHUNK_BITS]` is set.
+    uint32_t dv_entry_count;
+    uint32_t dv_chunk_count;
+    dv_chunk_t **dv_chunks;
+    uint64_t *dv_valid;
+
+    // Entries of deleted prefixes, reused before new ones.
+    uint32_t dv_free_head;
+
+    // Mirror of the entries (and command timestamps) kept for the next run, if the config names a state file.
+    state_file_t state_file;
+    // The table was reloaded from the state file rather than filled from the config alone.
+    uint8_t is_warm_started;
 } router_data_t;
 
+typedef struct router_link {
+    router_instance_t *router;
+    uint8_t link;
+    // What `route()` currently uses, which it may derive from measurements of the link.
+    uint8_t weight;
+    // From the config, only changed by `router_reload()`. Kept in the state file, since measurements do not survive a restart.
+    uint8_t configured_weight;
+    uint32_t neighbour_subnet;
+    token_bucket_t buckets[RATE_CLASS_COUNT];
+
+    // Where the link is (re)opened, see `link_connect()`.
+    char address[LINK_ADDRESS_MAX];
+    const transport_ops_t *transport_ops;
+
+    // Only the link's own thread opens and closes its transport, with the lock held for writing.
+    // Senders on other threads hold it for reading, and skip the link while it is down.
+    pthread_rwlock_t transport_lock;
+    uint8_t is_up;
+    transport_t transport;
+    pthread_t thread;
+} router_link_t;
+
+struct router_instance {
+    // Position of the router's network simulation address on the command line.
+    uint32_t id;
+    const char *netsim_address;
+    uint8_t address;
+    uint8_t app_address;
+
+    // Initialise with specific values.
+    router_data_t data;
+
+    int error_socket;
+    // Abstract behind API, throw error when offset is wrong.
+    // `link_count` links to the network simulation, followed by the application link.
+    uint8_t link_count;
+    router_link_t *links;
+    atomic_int links_yet_inactive;
+
+    // Ingress limits from the config. Source buckets are shared by every link.
+    rate_limit_t rate_limits[RATE_CLASS_COUNT][RATE_SCOPE_COUNT];
+    token_bucket_t source_buckets[RATE_LIMIT_SOURCE_COUNT][RATE_CLASS_COUNT];
+
+    // How `route()` advertises the table, see `router_get_split_horizon()` and `router_get_delta_updates()`.
+    uint8_t split_horizon;
+    uint8_t delta_updates;
+    uint32_t coalesce_ms;
+
+    // Timers of `route()` (See `router_timer_start()`), ticked in milliseconds by `timer_handler()`.
+    timer_wheel_t timer_wheel;
+    pthread_mutex_t timer_mutex;
+    pthread_cond_t timer_cond;
+    pthread_t timer_thread;
+    // Timers in the wheel, or expired and waiting for their function to be called.
+    uint32_t timer_count;
+    // The tick `timer_handler()` sleeps until, `UINT64_MAX` while the wheel is empty.
+    uint64_t timer_wakeup_ms;
+    uint8_t is_timer_stopping;
+
+    uint32_t refresh_ms;
+    uint32_t route_timeout_ms;
+    uint32_t holddown_ms;
+    uint32_t hello_ms;
+    uint8_t hello_multiplier;
+    uint32_t stale_ms;
+    uint32_t duplicate_ms;
+    uint32_t latency_cost_ms;
+    uint32_t queue_cost_bytes;
+
+    // Multicast groups from the config (See `router_get_multicast_group()`).
+    uint64_t multicast_links[CONFIG_MULTICAST_ADDRESSES];
+    uint64_t multicast_app[CONFIG_MULTICAST_ADDRESSES / 64];
+    uint64_t multicast_groups[CONFIG_MULTICAST_ADDRESSES / 64];
+
+    uint8_t current_test_id;
+
+    // Packets and drops of each link and thread, published if the config names them.
+    stats_t stats;
+
+    // Owned by `route()`, see `router_set_route_state()`.
+    void *route_state;
+};
+
+/**
+ * The config file routers were started from, reloaded on `SIGHUP` (See `reload_handler()`).
+ */
+typedef struct reload_context {
+    const char *path;
+    router_instance_t *routers;
+    uint32_t router_count;
+    pthread_t thread;
+    atomic_int is_stopping;
+} reload_context_t;
+
 //=====================================
-//      DATA
+//      TABLE HELPERS
 //=====================================
 
-static int error_socket;
-// Abstract behind API, throw error when offset is wrong.
-static int link_sockets[TOTAL_LINK_COUNT];
-static int links_yet_inactive = TOTAL_LINK_COUNT;
+static inline dv_chunk_t *dv_chunk_of(const router_data_t *data, const uint32_t index) {
+    return data->dv_chunks[index >> DV_CHUNK_BITS];
+}
+
+static inline dv_entry_t *dv_at(const router_data_t *data, const uint32_t index) {
+    return &dv_chunk_of(data, index)->entries[DV_SLOT(index)];
+}
+
+static inline int dv_is_valid(const router_data_t *data, const uint32_t index) {
+    return (data->dv_valid[index >> DV_CHUNK_BITS] >> DV_SLOT(index)) & 1;
+}
+
+static dv_entry_t *dv_prefix_get(const router_data_t *data, const uint32_t prefix, const uint8_t prefix_len) {
+    const uint32_t index = lpm_find(&data->lpm, prefix, prefix_len);
+    return index == LPM_NO_ROUTE ? NULL : dv_at(data, index);
+}
+
+/**
+ * Writes entry `index` through to the state file, if there is one.
+ */
+static void dv_persist(router_data_t *data, const uint32_t index) {
+    if(!data->state_file.header) return;
+
+    const dv_chunk_t *chunk = dv_chunk_of(data, index);
+    state_entry_t record = {};
+    if(dv_is_valid(data, index)) {
+        record.prefix = chunk->prefixes[DV_SLOT(index)];
+        record.is_valid = 1;
+        record.prefix_len = chunk->prefix_lens[DV_SLOT(index)];
+        record.cost = chunk->entries[DV_SLOT(index)].cost;
+        record.next_hop_link = chunk->entries[DV_SLOT(index)].next_hop_link;
+    }
+    state_file_set(&data->state_file, index, &record);
+}
+
+/**
+ * Sets the entry of a prefix, adding it to the table if it is new.
+ * Return Value - The entry, or NULL if the table is out of memory.
+ */
+static dv_entry_t *dv_prefix_set(router_data_t *data, const uint32_t prefix, const uint8_t prefix_len, const uint8_t cost, const uint8_t next_hop_link) {
+    uint32_t index = lpm_find(&data->lpm, prefix, prefix_len);
+
+    if(index == LPM_NO_ROUTE) {
+        const int is_reused = data->dv_free_head != DV_NO_ENTRY;
+        index = is_reused ? data->dv_free_head : data->dv_entry_count;
+        dv_chunk_t **chunk = &data->dv_chunks[index >> DV_CHUNK_BITS];
+        if(!*chunk && !(*chunk = calloc(1, sizeof(dv_chunk_t)))) return NULL;
+        if(lpm_add(&data->lpm, prefix, prefix_len, index) != 0) return NULL;
+
+        if(is_reused) data->dv_free_head = (*chunk)->prefixes[DV_SLOT(index)];
+        else data->dv_entry_count += 1;
+
+        (*chunk)->prefixes[DV_SLOT(index)] = prefix;
+        (*chunk)->prefix_lens[DV_SLOT(index)] = prefix_len;
+        data->dv_valid[index >> DV_CHUNK_BITS] |= UINT64_C(1) << DV_SLOT(index);
+    }
+
+    dv_entry_t *entry = dv_at(data, index);
+    entry->cost = cost;
+    entry->next_hop_link = next_hop_link;
+    dv_persist(data, index);
+    return entry;
+}
 
-// Initialise with specific values.
-static router_data_t router;
+/**
+ * Removes the entry of a prefix and puts it on the free list.
+ * Return Value - 0 if the entry was removed, -1 if there was no such entry.
+ */
+static int dv_prefix_delete(router_data_t *data, const uint32_t prefix, const uint8_t prefix_len) {
+    const uint32_t index = lpm_find(&data->lpm, prefix, prefix_len);
+    if(index == LPM_NO_ROUTE || lpm_delete(&data->lpm, prefix, prefix_len) != 0) return -1;
+
+    data->dv_valid[index >> DV_CHUNK_BITS] &= ~(UINT64_C(1) << DV_SLOT(index));
+    dv_chunk_of(data, index)->prefixes[DV_SLOT(index)] = data->dv_free_head;
+    data->dv_free_head = index;
+    dv_persist(data, index);
+    return 0;
+}
 
-static const uint8_t NEIGHBOUR_SUBNETS[NETSIM_LINK_COUNT] = { 2, 5, 18, 45 };
+/**
+ * Fills the table with the entries a previous run left in the state file.
+ * They are written back as they are added, since their positions in the table may differ from last time.
+ * Return Value - The number of entries reloaded.
+ */
+static uint32_t dv_reload(router_data_t *data) {
+    state_file_t *file = &data->state_file;
+    const uint32_t end = file->header->entry_end;
+
+    state_entry_t *records = malloc(sizeof(state_entry_t) * (end ? end : 1));
+    expect(records, "state file reload");
+    memcpy(records, file->entries, sizeof(state_entry_t) * end);
+    state_file_clear(file);
+
+    uint32_t count = 0;
+    for(uint32_t i = 0; i < end; i++) {
+        const state_entry_t *record = &records[i];
+        if(!record->is_valid || record->prefix_len > data->address_bits || record->prefix >> data->address_bits) continue;
+
+        expect(dv_prefix_set(data, record->prefix, record->prefix_len, record->cost, record->next_hop_link), "state file reload");
+        count += 1;
+    }
 
-static uint8_t current_test_id = 0;
+    free(records);
+    return count;
+}
+
+static uint64_t timer_now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / TIMER_TICK_NS;
+}
 
 //=====================================
 //      ROUTER FUNCTIONS
 //=====================================
 
-void router_init(void) {
-    memset(&router, 0, sizeof(router));
-    
-    // Set link weights.
-    const uint8_t LINK_WEIGHTS[NETSIM_LINK_COUNT] = { 2, 3, 2, 11 };
-    for(int i = 0; i < NETSIM_LINK_COUNT; i++) {
-        router.link_weights[i] = LINK_WEIGHTS[i];
-    }
-
-    // Fill initial routing table.
-    router.dv_entry_count = 5;
-    const uint8_t INITIAL_DEST_SUBNETS[5] = { 2, 3, 5, 18, 45 };
-    const uint8_t INITIAL_COSTS[5] = { 2, 0, 3, 2, 11 };
-    const uint8_t INITIAL_NEXT_HOP_LINKS[5] = { 0, ERROR_VALUE, 1, 2, 3 };
-    for(int i = 0; i < 5; i++) {
-        dv_entry_wrapper_t entry = {
-            1,
-            INITIAL_DEST_SUBNETS[i],
-            {
-                INITIAL_COSTS[i],
-                INITIAL_NEXT_HOP_LINKS[i]
-            }
-        };
-        router.dv[INITIAL_DEST_SUBNETS[i]] = entry;
+void router_init(router_instance_t *router, const uint32_t id, const router_config_t *config) {
+    memset(router, 0, sizeof(*router));
+    router->id = id;
+    router->netsim_address = config->netsim_address;
+    router->address = config->address;
+    router->app_address = config->app_address;
+    router->error_socket = -1;
+    memcpy(router->rate_limits, config->rate_limits, sizeof(router->rate_limits));
+    router->split_horizon = config->split_horizon;
+    router->delta_updates = config->delta_updates;
+    router->coalesce_ms = config->coalesce_ms;
+    router->refresh_ms = config->refresh_ms;
+    router->route_timeout_ms = config->route_timeout_ms;
+    router->holddown_ms = config->holddown_ms;
+    router->hello_ms = config->hello_ms;
+    router->hello_multiplier = config->hello_multiplier;
+    router->stale_ms = config->stale_ms;
+    router->duplicate_ms = config->duplicate_ms;
+    router->latency_cost_ms = config->latency_cost_ms;
+    router->queue_cost_bytes = config->queue_cost_bytes;
+    memcpy(router->multicast_links, config->multicast_links, sizeof(router->multicast_links));
+    memcpy(router->multicast_app, config->multicast_app, sizeof(router->multicast_app));
+    memcpy(router->multicast_groups, config->multicast_groups, sizeof(router->multicast_groups));
+
+    // `route_init()` may already start timers.
+    timer_wheel_init(&router->timer_wheel, timer_now_ms());
+    router->timer_wakeup_ms = UINT64_MAX;
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    expect(pthread_mutex_init(&router->timer_mutex, NULL) == 0, "timer mutex");
+    expect(pthread_cond_init(&router->timer_cond, &cond_attr) == 0, "timer condition");
+    pthread_condattr_destroy(&cond_attr);
+
+    router->link_count = config->link_count;
+    router->links = calloc(router->link_count + 1, sizeof(router_link_t));
+    expect(router->links, "router links allocation");
+    expect(stats_open(&router->stats, config->stats_name, router->address, router->link_count, STATS_ROW_COUNT(router)) == 0, "stats open");
+    atomic_init(&router->links_yet_inactive, router->link_count + 1);
+
+    for(int i = 0; i <= router->link_count; i++) {
+        router->links[i].router = router;
+        router->links[i].link = i;
+        router->links[i].transport.fd = -1;
+        pthread_rwlock_init(&router->links[i].transport_lock, NULL);
+    }
+
+    // Set link weights and neighbours.
+    for(int i = 0; i < router->link_count; i++) {
+        router->links[i].weight = config->links[i].weight;
+        router->links[i].configured_weight = config->links[i].weight;
+        router->links[i].neighbour_subnet = config->links[i].neighbour_subnet;
+    }
+
+    // One entry for every possible prefix at most, though chunks are only allocated once used.
+    router_data_t *data = &router->data;
+    data->address_bits = config->address_bits;
+    expect(lpm_init(&data->lpm, data->address_bits) == 0, "routing table allocation");
+
+    const uint64_t max_entry_count = (UINT64_C(2) << data->address_bits) - 1;
+    data->dv_chunk_count = (max_entry_count + DV_CHUNK_SIZE - 1) / DV_CHUNK_SIZE;
+    data->dv_chunks = calloc(data->dv_chunk_count, sizeof(dv_chunk_t *));
+    data->dv_valid = calloc(data->dv_chunk_count, sizeof(uint64_t));
+    expect(data->dv_chunks && data->dv_valid, "routing table allocation");
+    data->dv_free_head = DV_NO_ENTRY;
+
+    // Warm start: take up the table where the last run left it. Its routes are kept (and used) until neighbours confirm them.
+    data->state_file.fd = -1;
+    if(config->state_file[0]) {
+        state_header_t expected = {};
+        expected.address = router->address;
+        expected.address_bits = data->address_bits;
+        expected.link_count = router->link_count;
+        expected.entry_capacity = max_entry_count;
+        for(int i = 0; i < router->link_count; i++) {
+            expected.link_weights[i] = router->links[i].configured_weight;
+        }
+
+        const int status = state_file_open(&data->state_file, config->state_file, &expected);
+        expect(status >= 0, "state file open");
+        if(status == 1) {
+            const uint32_t count = dv_reload(data);
+            data->is_warm_started = count > 0;
+            print("[*] Router %u: %u entries reloaded from %s\n", router->address, count, config->state_file);
+        }
+    }
+
+    // Fill initial routing table: the router's own subnet, then the cheapest link to each neighbour.
+    expect(dv_prefix_set(data, SUBNET(router->address), data->address_bits, 0, NO_NEXT_HOP_LINK), "routing table fill");
+
+    for(int i = 0; i < router->link_count; i++) {
+        const router_link_t *link = &router->links[i];
+        const dv_entry_t *entry = dv_prefix_get(data, link->neighbour_subnet, data->address_bits);
+        if(entry && entry->cost <= link->weight) continue;
+
+        expect(dv_prefix_set(data, link->neighbour_subnet, data->address_bits, link->weight, i), "routing table fill");
+    }
+
+    int route_init(router_instance_t *router);
+    expect(route_init(router) == 0, "route state allocation");
+}
+
+void router_destroy(router_instance_t *router) {
+    void route_destroy(router_instance_t *router);
+    route_destroy(router);
+    pthread_mutex_destroy(&router->timer_mutex);
+    pthread_cond_destroy(&router->timer_cond);
+
+    if(router->error_socket >= 0) close(router->error_socket);
+    for(int i = 0; i <= router->link_count; i++) {
+        transport_close(&router->links[i].transport);
+        pthread_rwlock_destroy(&router->links[i].transport_lock);
+    }
+    free(router->links);
+    router->links = NULL;
+    stats_close(&router->stats);
+
+    router_data_t *data = &router->data;
+    for(uint32_t i = 0; i < data->dv_chunk_count; i++) {
+        free(data->dv_chunks[i]);
     }
+    free(data->dv_chunks);
+    free(data->dv_valid);
+    lpm_free(&data->lpm);
+    state_file_close(&data->state_file);
+
+    free(router->route_state);
+    router->route_state = NULL;
+}
+
+int router_get_link_count(const router_instance_t *router) {
+    return router->link_count;
+}
+
+uint8_t router_get_address(const router_instance_t *router) {
+    return router->address;
+}
+
+uint8_t router_get_app_address(const router_instance_t *router) {
+    return router->app_address;
 }
 
-int router_get_link_weight(const uint8_t link) {
-    if(link >= NETSIM_LINK_COUNT) {
+int router_get_link_weight(const router_instance_t *router, const uint8_t link) {
+    if(link >= router->link_count) {
         warn("`router_get_link_weight()`: Argument `link` is out of bounds\n");
         return -1;
     }
 
-    return router.link_weights[link];
+    return router->links[link].weight;
 }
 
-int router_get_neighbour_subnet(const uint8_t link) {
-    if(link >= NETSIM_LINK_COUNT) {
+int router_set_link_weight(router_instance_t *router, const uint8_t link, const uint8_t weight) {
+    if(link >= router->link_count) {
+        warn("`router_set_link_weight()`: Argument `link` is out of bounds\n");
+        return -1;
+    }
+
+    router->links[link].weight = weight;
+    return 0;
+}
+
+int router_get_neighbour_subnet(const router_instance_t *router, const uint8_t link) {
+    if(link >= router->link_count) {
         warn("`router_get_neighbour_subnet()`: Argument `link` is out of bounds\n");
         return -1;
     }
 
-    return NEIGHBOUR_SUBNETS[link];
+    return router->links[link].neighbour_subnet;
+}
+
+int router_get_split_horizon(const router_instance_t *router) {
+    return router->split_horizon;
+}
+
+int router_get_delta_updates(const router_instance_t *router) {
+    return router->delta_updates;
+}
+
+int router_get_coalesce_window_ms(const router_instance_t *router) {
+    return router->coalesce_ms;
+}
+
+int router_get_refresh_interval_ms(const router_instance_t *router) {
+    return router->refresh_ms;
+}
+
+int router_get_route_timeout_ms(const router_instance_t *router) {
+    return router->route_timeout_ms;
+}
+
+int router_get_holddown_ms(const router_instance_t *router) {
+    return router->holddown_ms;
+}
+
+int router_is_warm_started(const router_instance_t *router) {
+    return router->data.is_warm_started;
+}
+
+int router_get_stale_ms(const router_instance_t *router) {
+    return router->stale_ms;
+}
+
+uint32_t router_get_link_timestamp(const router_instance_t *router, const uint8_t link) {
+    const state_header_t *header = router->data.state_file.header;
+    if(link >= router->link_count) {
+        warn("`router_get_link_timestamp()`: Argument `link` is out of bounds\n");
+        return 0;
+    }
+
+    return header ? header->link_timestamps[link] : 0;
+}
+
+void router_set_link_timestamp(router_instance_t *router, const uint8_t link, const uint32_t timestamp) {
+    state_header_t *header = router->data.state_file.header;
+    if(link >= router->link_count) {
+        warn("`router_set_link_timestamp()`: Argument `link` is out of bounds\n");
+        return;
+    }
+
+    if(header) header->link_timestamps[link] = timestamp;
+}
+
+int router_get_hello_interval_ms(const router_instance_t *router) {
+    return router->hello_ms;
+}
+
+int router_get_hello_multiplier(const router_instance_t *router) {
+    return router->hello_multiplier;
+}
+
+int router_get_duplicate_window_ms(const router_instance_t *router) {
+    return router->duplicate_ms;
+}
+
+int router_get_latency_cost_ms(const router_instance_t *router) {
+    return router->latency_cost_ms;
+}
+
+uint32_t router_get_queue_cost_bytes(const router_instance_t *router) {
+    return router->queue_cost_bytes;
+}
+
+int router_get_link_queue_bytes(router_instance_t *router, const uint8_t link) {
+    if(link >= router->link_count) {
+        warn("`router_get_link_queue_bytes()`: Argument `link` is out of bounds\n");
+        return -1;
+    }
+
+    router_link_t *router_link = &router->links[link];
+    int bytes = 0;
+    pthread_rwlock_rdlock(&router_link->transport_lock);
+    // Transports without a kernel socket (shared memory) have nothing queued by this measure.
+    if(!router_link->is_up || ioctl(router_link->transport.fd, TIOCOUTQ, &bytes) != 0) bytes = 0;
+    pthread_rwlock_unlock(&router_link->transport_lock);
+    return bytes;
+}
+
+int router_get_multicast_group(const router_instance_t *router, const uint8_t address, uint64_t *link_mask, int *is_app_member) {
+    if(!((router->multicast_groups[address / 64] >> (address % 64)) & 1)) return 0;
+
+    if(link_mask) *link_mask = router->multicast_links[address];
+    if(is_app_member) *is_app_member = (router->multicast_app[address / 64] >> (address % 64)) & 1;
+    return 1;
+}
+
+void router_timer_init(router_timer_t *timer, router_timer_fn_t fn, void *arg) {
+    memset(timer, 0, sizeof(*timer));
+    timer->fn = fn;
+    timer->arg = arg;
+}
+
+void router_timer_start(router_instance_t *router, router_timer_t *timer, const uint32_t delay_ms) {
+    pthread_mutex_lock(&router->timer_mutex);
+    if(timer_wheel_is_pending(timer)) {
+        timer_wheel_remove(timer);
+        router->timer_count -= 1;
+    }
+
+    // The wheel stands still while it is empty, so it is moved up to the clock instead of turned through the idle ticks.
+    const uint64_t now_ms = timer_now_ms();
+    if(router->timer_count == 0) router->timer_wheel.now = now_ms;
+
+    // The wheel may lag behind the clock by the ticks not yet turned, so the delay is counted from now.
+    timer_wheel_add(&router->timer_wheel, timer, now_ms + delay_ms);
+    router->timer_count += 1;
+    if(timer->expires < router->timer_wakeup_ms) pthread_cond_signal(&router->timer_cond);
+    pthread_mutex_unlock(&router->timer_mutex);
+}
+
+void router_timer_stop(router_instance_t *router, router_timer_t *timer) {
+    pthread_mutex_lock(&router->timer_mutex);
+    if(timer_wheel_is_pending(timer)) {
+        timer_wheel_remove(timer);
+        router->timer_count -= 1;
+    }
+    pthread_mutex_unlock(&router->timer_mutex);
+}
+
+int router_timer_is_pending(router_instance_t *router, const router_timer_t *timer) {
+    pthread_mutex_lock(&router->timer_mutex);
+    const int is_pending = timer_wheel_is_pending(timer);
+    pthread_mutex_unlock(&router->timer_mutex);
+    return is_pending;
+}
+
+void router_set_route_state(router_instance_t *router, void *state) {
+    router->route_state = state;
+}
+
+void *router_get_route_state(const router_instance_t *router) {
+    return router->route_state;
+}
+
+int router_get_address_bits(const router_instance_t *router) {
+    return router->data.address_bits;
+}
+
+const dv_entry_t *dv_lookup(const router_instance_t *router, const uint32_t dest) {
+    const router_data_t *data = &router->data;
+    if(dest >> data->address_bits) {
+        warn("`dv_lookup()`: Argument `dest` is out of bounds\n");
+        return NULL;
+    }
+
+    const uint32_t index = lpm_lookup(&data->lpm, dest);
+    return index == LPM_NO_ROUTE ? NULL : dv_at(data, index);
+}
+
+const dv_entry_t *dv_get_prefix_entry(const router_instance_t *router, const uint32_t prefix, const uint8_t prefix_len) {
+    const router_data_t *data = &router->data;
+    if(prefix_len > data->address_bits || prefix >> data->address_bits) {
+        warn("`dv_get_prefix_entry()`: Argument `prefix` or `prefix_len` is out of bounds\n");
+        return NULL;
+    }
+
+    return dv_prefix_get(data, prefix, prefix_len);
+}
+
+int dv_set_prefix_entry(router_instance_t *router, const uint32_t prefix, const uint8_t prefix_len, const uint8_t cost, const uint8_t next_hop_link) {
+    router_data_t *data = &router->data;
+    if(prefix_len > data->address_bits || prefix >> data->address_bits) {
+        warn("`dv_set_prefix_entry()`: Argument `prefix` or `prefix_len` is out of bounds\n");
+        return -1;
+    }
+
+    if(!dv_prefix_set(data, prefix, prefix_len, cost, next_hop_link)) return -1;
+
+    // log dv entry (the log only knows whole subnets)
+    if(prefix_len == data->address_bits && prefix <= UINT8_MAX) {
+        log_dv_set(prefix, cost, next_hop_link);
+    }
+
+    return 0;
 }
 
-const dv_entry_t *dv_get_entry(const uint8_t dest_subnet) {
-    if(dest_subnet >= SUBNET_ADDRESS_MAX) {
+const dv_entry_t *dv_get_entry(const router_instance_t *router, const uint32_t dest_subnet) {
+    if(dest_subnet >> router->data.address_bits) {
         warn("`dv_get_entry()`: Argument `dest_subnet` is out of bounds\n");
         return NULL;
     }
 
-    dv_entry_wrapper_t *wrapper = &router.dv[dest_subnet];
-    return wrapper->is_valid ? &wrapper->entry : NULL;
+    return dv_get_prefix_entry(router, dest_subnet, router->data.address_bits);
 }
 
-int dv_set_entry(const uint8_t dest_subnet, const uint8_t cost, const uint8_t next_hop_link) {
-    if(dest_subnet >= SUBNET_ADDRESS_MAX) {
+int dv_set_entry(router_instance_t *router, const uint32_t dest_subnet, const uint8_t cost, const uint8_t next_hop_link) {
+    if(dest_subnet >> router->data.address_bits) {
         warn("`dv_set_entry()`: Argument `dest_subnet` is out of bounds\n");
         return -1;
     }
 
-    dv_entry_wrapper_t *wrapper = &router.dv[dest_subnet];
-    if(!wrapper->is_valid) router.dv_entry_count += 1;
+    return dv_set_prefix_entry(router, dest_subnet, router->data.address_bits, cost, next_hop_link);
+}
+
+int dv_delete_prefix_entry(router_instance_t *router, const uint32_t prefix, const uint8_t prefix_len) {
+    router_data_t *data = &router->data;
+    if(prefix_len > data->address_bits || prefix >> data->address_bits) {
+        warn("`dv_delete_prefix_entry()`: Argument `prefix` or `prefix_len` is out of bounds\n");
+        return -1;
+    }
 
-    wrapper->is_valid = 1;
-    wrapper->dest_subnet = dest_subnet;
-    wrapper->entry.cost = cost;
-    wrapper->entry.next_hop_link = next_hop_link;
+    if(dv_prefix_delete(data, prefix, prefix_len) != 0) return -1;
 
-    // log dv entry
-    log_dv_set(dest_subnet, cost, next_hop_link);
+    // log the withdrawal as an unreachable entry
+    if(prefix_len == data->address_bits && prefix <= UINT8_MAX) {
+        log_dv_set(prefix, DV_COST_INFINITY, NO_NEXT_HOP_LINK);
+    }
 
     return 0;
 }
 
-void dv_print(void) {
-    for(int i = 0; i < SUBNET_ADDRESS_MAX; i++) {
-        dv_entry_wrapper_t *wrapper = &router.dv[i];
-        if(wrapper->is_valid) {
-            print("dest %u : [cost %u, next_hop_link %u]\n", wrapper->dest_subnet, wrapper->entry.cost, wrapper->entry.next_hop_link);
+int dv_delete_entry(router_instance_t *router, const uint32_t dest_subnet) {
+    if(dest_subnet >> router->data.address_bits) {
+        warn("`dv_delete_entry()`: Argument `dest_subnet` is out of bounds\n");
+        return -1;
+    }
+
+    return dv_delete_prefix_entry(router, dest_subnet, router->data.address_bits);
+}
+
+const dv_entry_t *dv_next_entry(const router_instance_t *router, uint32_t *cursor, uint32_t *prefix, uint8_t *prefix_len) {
+    const router_data_t *data = &router->data;
+    const uint32_t word_count = (data->dv_entry_count + DV_CHUNK_SIZE - 1) >> DV_CHUNK_BITS;
+
+    // Only the words of the validity bitmap are scanned, one bit per valid entry is visited.
+    uint32_t word = *cursor >> DV_CHUNK_BITS;
+    if(word >= word_count) return NULL;
+    uint64_t bits = data->dv_valid[word] & (UINT64_MAX << DV_SLOT(*cursor));
+    while(!bits) {
+        if(++word >= word_count) {
+            *cursor = word << DV_CHUNK_BITS;
+            return NULL;
         }
+        bits = data->dv_valid[word];
+    }
+
+    const uint32_t index = (word << DV_CHUNK_BITS) | __builtin_ctzll(bits);
+    const dv_chunk_t *chunk = dv_chunk_of(data, index);
+    *cursor = index + 1;
+    if(prefix) *prefix = chunk->prefixes[DV_SLOT(index)];
+    if(prefix_len) *prefix_len = chunk->prefix_lens[DV_SLOT(index)];
+    return &chunk->entries[DV_SLOT(index)];
+}
+
+void dv_print(const router_instance_t *router) {
+    uint32_t cursor = 0;
+    uint32_t prefix;
+    uint8_t prefix_len;
+    const dv_entry_t *entry;
+    while((entry = dv_next_entry(router, &cursor, &prefix, &prefix_len))) {
+        print("dest %u/%u : [cost %u, next_hop_link %u]\n", prefix, prefix_len, entry->cost, entry->next_hop_link);
     }
 }
 
@@ -174,18 +779,99 @@ void dv_print(void) {
 //      OTHER API FUNCTIONS
 //=====================================
 
-int send_buffer_to_link(const uint8_t link, const uint8_t *buf, const uint8_t size) {
-    if(link >= NETSIM_LINK_COUNT) return -1;
-    if(send(link_sockets[link], buf, size, 0) != size) return -1;
-    
+/**
+ * Sends a packet over a link to the network simulation, unless the link is down.
+ * Return Value - 0 if the packet was sent, else -1.
+ */
+static int link_send(router_link_t *router_link, const uint8_t *buf, const uint8_t size) {
+    pthread_rwlock_rdlock(&router_link->transport_lock);
+    const int status = router_link->is_up ? transport_send(&router_link->transport, buf, size) : -1;
+    pthread_rwlock_unlock(&router_link->transport_lock);
+    return status;
+}
+
+int send_buffer_to_link(router_instance_t *router, const uint8_t link, const uint8_t *buf, const uint8_t size) {
+    if(link >= router->link_count) return -1;
+    if(link_send(&router->links[link], buf, size) != 0) return -1;
+    stats_count_tx(&router->stats, link, 1, size);
+
     // log
     log_send_to_link(buf, size, link);
 
     return 0;
 }
 
-int send_buffer_to_app(const uint8_t *buf, const uint8_t size) {
-    if(send(link_sockets[APP_LINK], buf, size, 0) != size) return -1;
+int send_buffers_to_link(router_instance_t *router, const uint8_t link, uint8_t *const *bufs, const uint8_t *sizes, const int count) {
+    if(link >= router->link_count || count <= 0 || count > ROUTE_BATCH_MAX) return -1;
+
+    transport_msg_t msgs[ROUTE_BATCH_MAX];
+    for(int i = 0; i < count; i++) {
+        msgs[i].buf = bufs[i];
+        msgs[i].size = sizes[i];
+    }
+
+    router_link_t *router_link = &router->links[link];
+    pthread_rwlock_rdlock(&router_link->transport_lock);
+    const int sent = router_link->is_up ? router_link->transport.ops->send_batch(&router_link->transport, msgs, count) : -1;
+    pthread_rwlock_unlock(&router_link->transport_lock);
+    if(sent <= 0) return -1;
+
+    // log
+    uint64_t sent_bytes = 0;
+    for(int i = 0; i < sent; i++) {
+        log_send_to_link(bufs[i], sizes[i], link);
+        sent_bytes += sizes[i];
+    }
+    stats_count_tx(&router->stats, link, sent, sent_bytes);
+
+    return sent;
+}
+
+int send_buffer_to_links(router_instance_t *router, const uint64_t link_mask, uint8_t *buf, const uint8_t size, const uint8_t patch_dest) {
+    if(size < HEADER_SIZE) return -1;
+    if(link_mask & ~ROUTER_LINKS_MASK(router->link_count)) return -1;
+
+    // Sum of every byte except the destination (checksum byte taken as zero), computed once.
+    // Each copy then only folds in its own destination, the same way `packet_serialise()` does.
+    uint16_t base_sum = 0;
+    if(patch_dest) {
+        buf[6] = 0;
+        for(uint8_t i = 0; i < size; i++) {
+            base_sum += buf[i];
+        }
+        base_sum -= buf[1];
+    }
+
+    // Only distance vector advertisements count as broadcasts, hellos and multicast copies are counted as plain sends.
+    const int is_advertisement = ((buf[4] & 0xF0) >> 4) == PACKET_TYPE_COMMAND;
+
+    int status = 0;
+    for(uint64_t mask = link_mask; mask; mask &= mask - 1) {
+        const uint8_t link = (uint8_t) __builtin_ctzll(mask);
+
+        if(patch_dest) {
+            buf[1] = router->links[link].neighbour_subnet << 2;
+            const uint16_t sum = base_sum + buf[1];
+            buf[6] = ~((sum & 0xFF) + ((sum >> 8) & 0xFF));
+        }
+
+        if(link_send(&router->links[link], buf, size) != 0) {
+            status = -1;
+            continue;
+        }
+        if(is_advertisement) stats_count_broadcast(&router->stats, link, size);
+        else stats_count_tx(&router->stats, link, 1, size);
+
+        // log
+        log_send_to_link(buf, size, link);
+    }
+
+    return status;
+}
+
+int send_buffer_to_app(router_instance_t *router, const uint8_t *buf, const uint8_t size) {
+    if(transport_send(&router->links[APP_LINK(router)].transport, buf, size) != 0) return -1;
+    stats_count_tx(&router->stats, APP_LINK(router), 1, size);
 
     // log
     log_send_to_app(buf, size);
@@ -197,12 +883,13 @@ int send_buffer_to_app(const uint8_t *buf, const uint8_t size) {
 //      FUNCTIONS
 //=====================================
 
-void print_results(void) {
+void print_results(const router_instance_t *router, const uint32_t router_count) {
     static char buf[4096] = {};
     memset(buf, 0, sizeof(buf));
-    expect(recv(error_socket, buf, sizeof(buf), 0) >= 0, "error message recv");
+    expect(recv(router->error_socket, buf, sizeof(buf), 0) >= 0, "error message recv");
     char *msg = strtok(buf, "\n");
-    print("\n==== RESULTS ====\n");
+    if(router_count > 1) print("\n==== RESULTS (%s) ====\n", router->netsim_address);
+    else print("\n==== RESULTS ====\n");
     while(msg) {
         char *result = strrchr(msg, ':');
         *result = 0;
@@ -220,130 +907,299 @@ void print_results(void) {
     }
 }
 
-void *link_handler(void *_link) {
-    while(links_yet_inactive > 0);
+void app_link_connect(router_instance_t *router) {
+    const char *app_link_type = getenv(APP_LINK_ENV);
+    if(!app_link_type) app_link_type = transport_tcp.name;
 
-    const uint8_t link = (const uint8_t) (long) _link;
-    int sock = link_sockets[link];
+    const transport_ops_t *transport = transport_find(app_link_type);
+    if(!transport) {
+        error("Unknown application link transport '%s'\n", app_link_type);
+        exit(1);
+    }
 
-    print("[*] Link %d established\n", link);
+    const char *address = APP_TCP_ADDRESS;
+    if(transport == &transport_unix) address = APP_SOCKET_PATH;
+    else if(transport == &transport_shm) address = APP_SHM_SOCKET_PATH;
 
-    int64_t exit_code = 0;
+    transport_t *link = &router->links[APP_LINK(router)].transport;
+    int attempts = 0;
+    while(transport_open(link, transport, address, TRANSPORT_CONNECT, APP_INITIAL_BYTE) != 0) {
+        transport_close(link);
+        expect(++attempts < APP_CONNECT_ATTEMPTS, "app link open");
+        usleep(APP_CONNECT_RETRY_US);
+    }
+    print("[*] Link established with application (%s)\n", transport->name);
+}
 
-    uint8_t buf[MAX_PACKET_SIZE];
-    while(1) {
-        memset(buf, 0, MAX_PACKET_SIZE);
-        ssize_t bytes_read = recv(sock, buf, MAX_PACKET_SIZE, 0);
-        expect(bytes_read > 0, "link packet recv");
-        expect(bytes_read <= UINT8_MAX, "packet too big");
-        uint8_t size = (uint8_t) bytes_read;
-
-        int flag_err = (buf[3] & (1 << 4)) != 0;
-        int flag_end = (buf[3] & (1 << 5)) != 0;
-
-        if(flag_err) {
-            exit_code = 1;
-            break;
+/**
+ * Checks a packet from the network simulation against the rate limits of its class, for its link and its source.
+ * The source of a packet is only trusted once it deserialises, so a corrupted packet cannot use up the bucket
+ * of whatever source its first byte names. It is left for `route()` to drop.
+ * Return Value - 1 if the packet may be routed, 0 if it must be dropped.
+ */
+static int ingress_allowed(router_link_t *router_link, const uint8_t *buf, const uint8_t size, const uint64_t now_ns) {
+    router_instance_t *router = router_link->router;
+    // Hellos are control traffic like commands.
+    const rate_class_t class = (buf[4] >> 4) != PACKET_TYPE_DATA ? RATE_CLASS_COMMAND : RATE_CLASS_DATA;
+    const rate_limit_t *limits = router->rate_limits[class];
+
+    if(!token_bucket_take(&router_link->buckets[class], &limits[RATE_SCOPE_LINK], now_ns)) return 0;
+    if(limits[RATE_SCOPE_SOURCE].rate == 0) return 1;
+
+    packet_t pkt;
+    if(packet_deserialise(&pkt, buf, size) != 0) return 1;
+    return token_bucket_take(&router->source_buckets[pkt.src][class], &limits[RATE_SCOPE_SOURCE], now_ns);
+}
+
+/**
+ * Opens a link to the network simulation, retrying with exponential backoff.
+ * The transport is opened aside and only swapped in once it works, so senders never see it half open.
+ * Return Value - 0 once the link is up, -1 if every attempt failed.
+ */
+static int link_connect(router_link_t *router_link) {
+    useconds_t retry_us = LINK_RETRY_MIN_US;
+    for(int attempt = 1; attempt <= LINK_CONNECT_ATTEMPTS; attempt++) {
+        // The hello byte is the link ID.
+        transport_t transport;
+        if(transport_open(&transport, router_link->transport_ops, router_link->address, TRANSPORT_CONNECT, router_link->link) == 0) {
+            pthread_rwlock_wrlock(&router_link->transport_lock);
+            router_link->transport = transport;
+            router_link->is_up = 1;
+            pthread_rwlock_unlock(&router_link->transport_lock);
+            return 0;
         }
-        else if(flag_end) {
-            exit_code = 0;
-            break;
+        transport_close(&transport);
+
+        usleep(retry_us);
+        retry_us = retry_us * 2 < LINK_RETRY_MAX_US ? retry_us * 2 : LINK_RETRY_MAX_US;
+    }
+
+    warn("Link %d: could not connect to %s\n", router_link->link, router_link->address);
+    return -1;
+}
+
+/**
+ * Closes a link whose peer went away. Senders skip it from then on.
+ */
+static void link_disconnect(router_link_t *router_link) {
+    pthread_rwlock_wrlock(&router_link->transport_lock);
+    router_link->is_up = 0;
+    transport_close(&router_link->transport);
+    pthread_rwlock_unlock(&router_link->transport_lock);
+}
+
+void *link_handler(void *_link) {
+    router_link_t *router_link = _link;
+    router_instance_t *router = router_link->router;
+    transport_t *transport = &router_link->transport;
+    const uint8_t link = router_link->link;
+    void route_link_changed(router_instance_t *router, const uint8_t link, const int is_up);
+    void route(router_instance_t *router, uint8_t *buf, const uint8_t size, const uint8_t link);
+    void route_batch(router_instance_t *router, route_msg_t *msgs, const int count);
+
+    stats_bind_thread(&router->stats, link, link);
+
+    int64_t exit_code = -1;
+    const int is_netsim_link = link != APP_LINK(router);
+    if(is_netsim_link && link_connect(router_link) != 0) exit_code = 1;
+
+    while(atomic_load(&router->links_yet_inactive) > 0);
+
+    if(exit_code < 0) print("[*] Link %d established\n", link);
+
+    static __thread uint8_t bufs[TRANSPORT_BATCH_MAX][MAX_PACKET_SIZE];
+    transport_msg_t msgs[TRANSPORT_BATCH_MAX];
+    for(int i = 0; i < TRANSPORT_BATCH_MAX; i++) {
+        msgs[i].buf = bufs[i];
+    }
+
+    while(exit_code < 0) {
+        const int count = transport->ops->recv_batch(transport, msgs, TRANSPORT_BATCH_MAX);
+        if(count <= 0 && is_netsim_link) {
+            // The rest of the router keeps running: `route()` withdraws the routes over the link until it is back.
+            warn("Link %d lost, reconnecting\n", link);
+            link_disconnect(router_link);
+            route_link_changed(router, link, 0);
+
+            if(link_connect(router_link) != 0) {
+                exit_code = 1;
+                break;
+            }
+            print("[*] Link %d re-established\n", link);
+            route_link_changed(router, link, 1);
+            continue;
         }
+        expect(count > 0, "link packet recv");
+        const uint64_t now_ns = rate_limit_now();
 
-        if(link != APP_LINK) {
-            current_test_id += 1;
-            log_test_number(current_test_id);
+        // Packets from the application carry no test number, so they are routed together.
+        // Every packet from the network simulation is a test of its own, whose log must follow it.
+        route_msg_t batch[TRANSPORT_BATCH_MAX];
+        int batch_count = 0;
+
+        uint64_t received_bytes = 0;
+        for(int i = 0; i < count; i++) {
+            received_bytes += msgs[i].size;
         }
+        stats_count_rx(&router->stats, link, count, received_bytes);
+
+        for(int i = 0; i < count && exit_code < 0; i++) {
+            uint8_t *buf = msgs[i].buf;
+            uint8_t size = msgs[i].size;
+            memset(buf + size, 0, MAX_PACKET_SIZE - size);
+
+            int flag_err = (buf[3] & (1 << 4)) != 0;
+            int flag_end = (buf[3] & (1 << 5)) != 0;
+
+            if(flag_err) {
+                exit_code = 1;
+                break;
+            }
+            else if(flag_end) {
+                exit_code = 0;
+                break;
+            }
+
+            if(link == APP_LINK(router)) {
+                batch[batch_count].buf = buf;
+                batch[batch_count].size = size;
+                batch[batch_count].link = link;
+                batch_count += 1;
+                continue;
+            }
 
-        void route(uint8_t *buf, const uint8_t size, const uint8_t link);
+            router->current_test_id += 1;
+            log_test_number(router->current_test_id);
 
-        route(buf, size, link);
+            if(!ingress_allowed(router_link, buf, size, now_ns)) {
+                packet_drop(PACKET_DROP_RATE_LIMITED);
+                continue;
+            }
+
+            route(router, buf, size, link);
+        }
+
+        // Packets before an ERR/END packet are still routed.
+        if(batch_count > 0) route_batch(router, batch, batch_count);
     }
 
     print("[*] Link %d closing down\n", link);
     pthread_exit((void *) exit_code);
 }
 
-int main(const int argc, const char *argv[]) {
-    const char *app_ip = "127.0.0.1";
-
-    if(argc != 2) {
-        error("Expecting exactly 1 argument specifying the network simulation's IP address\n");
-        return 1;
-    }
+/**
+ * Turns a router's timer wheel, and calls the functions of the timers that expire.
+ * Sleeps until the next tick the wheel has anything to do at (See `timer_wheel_next_tick()`),
+ * woken earlier by `router_timer_start()` when it adds a timer due before then.
+ */
+void *timer_handler(void *_router) {
+    router_instance_t *router = _router;
+    // Timers have no link of their own, their drops count against the application link.
+    stats_bind_thread(&router->stats, STATS_TIMER_ROW(router), APP_LINK(router));
+
+    router_timer_t expired;
+    timer_list_init(&expired);
+
+    pthread_mutex_lock(&router->timer_mutex);
+    while(!router->is_timer_stopping) {
+        router->timer_wakeup_ms = timer_wheel_next_tick(&router->timer_wheel);
+        if(router->timer_wakeup_ms == UINT64_MAX) {
+            pthread_cond_wait(&router->timer_cond, &router->timer_mutex);
+            continue;
+        }
 
-    const char *netsim_ip = argv[1];
+        // Ticks are whole milliseconds of the monotonic clock (See `timer_now_ms()`).
+        if(router->timer_wakeup_ms > timer_now_ms()) {
+            const struct timespec deadline = {
+                .tv_sec = router->timer_wakeup_ms / 1000,
+                .tv_nsec = (router->timer_wakeup_ms % 1000) * TIMER_TICK_NS,
+            };
+            pthread_cond_timedwait(&router->timer_cond, &router->timer_mutex, &deadline);
+        }
 
-    // Test Packet parsing
-    int test_packet_parsing(void);
-    if(test_packet_parsing() == 0) {
-        print("\n");
-        error("Packet parsing is incorrect\n");
-        return 1;
-    }
-    else {
-        print("\n");
-        no_error("All packet parsing tests passed\n");
+        // Timers are taken off the expired list one at a time, so a function may stop any other timer in the meantime.
+        timer_wheel_advance(&router->timer_wheel, timer_now_ms(), &expired);
+        while(expired.next != &expired && !router->is_timer_stopping) {
+            router_timer_t *timer = expired.next;
+            timer_wheel_remove(timer);
+            router->timer_count -= 1;
+
+            router_timer_fn_t fn = timer->fn;
+            void *arg = timer->arg;
+            pthread_mutex_unlock(&router->timer_mutex);
+            fn(router, timer, arg);
+            pthread_mutex_lock(&router->timer_mutex);
+        }
     }
-    print("\n");
 
-    FILE *log_file = fopen("log/router_log", "ab");
-    if(!log_file) {
-        perror("log file open");
-        return 1;
+    // Timers left expired when stopping are no longer pending, their list goes away with this thread.
+    while(expired.next != &expired) {
+        timer_wheel_remove(expired.next);
+        router->timer_count -= 1;
     }
-    log_begin(log_file);
+    pthread_mutex_unlock(&router->timer_mutex);
 
-    router_init();
+    return NULL;
+}
 
-    pthread_t threads[TOTAL_LINK_COUNT];
-    pthread_attr_t attr;
-    expect(pthread_attr_init(&attr) == 0, "thread attribute init");
+void link_start(router_instance_t *router, const uint8_t link, const pthread_attr_t *attr) {
+    router_link_t *router_link = &router->links[link];
+    expect(pthread_create(&router_link->thread, attr, link_handler, router_link) == 0, "thread create");
+    atomic_fetch_sub(&router->links_yet_inactive, 1);
+}
+
+void router_start(router_instance_t *router, const pthread_attr_t *attr) {
+    const char *app_ip = "127.0.0.1";
+    const char *netsim_address = router->netsim_address;
+
+    // A directory instead of an IP address means the links are unix sockets inside it.
+    // The error port is then reached on the local host.
+    const int netsim_unix = netsim_address[0] == '/';
+
+    expect(pthread_create(&router->timer_thread, attr, timer_handler, router) == 0, "thread create");
+
+    app_link_connect(router);
+    link_start(router, APP_LINK(router), attr);
 
     struct sockaddr_in addr = {};
     addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = inet_addr(app_ip);
-    addr.sin_port = htons(APP_PORT);
-
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    expect(sock >= 0, "app socket");
-    expect(connect(sock, (struct sockaddr *) &addr, sizeof(addr)) >= 0, "app port connect");
-    uint8_t byte = APP_INITIAL_BYTE;
-    expect(send(sock, &byte, sizeof(uint8_t), 0) == sizeof(uint8_t), "app initial byte send");
-    print("[*] Link established with application\n");
-    link_sockets[APP_LINK] = sock;
-    expect(pthread_create(&threads[APP_LINK], &attr, link_handler, (void *) (long) APP_LINK) == 0, "thread create");
-    links_yet_inactive -= 1;
-
-    addr.sin_addr.s_addr = inet_addr(netsim_ip);
-
-    error_socket = socket(AF_INET, SOCK_STREAM, 0);
-    expect(error_socket >= 0, "error socket");
-    addr.sin_port = htons(ERROR_PORT);
-    expect(connect(error_socket, (struct sockaddr *) &addr, sizeof(addr)) >= 0, "error port connect");
-
-    for(int i = NETSIM_LINK_BEGIN; i <= NETSIM_LINK_END; i++) {
-        int sock = socket(AF_INET, SOCK_STREAM, 0);
-        expect(sock >= 0, "link socket");
+    addr.sin_addr.s_addr = inet_addr(netsim_unix ? app_ip : netsim_address);
 
-        addr.sin_port = htons(BASE_LINK_PORT + i);
-        expect(connect(sock, (struct sockaddr *) &addr, sizeof(addr)) >= 0, "link port connect");
+    router->error_socket = socket(AF_INET, SOCK_STREAM, 0);
+    expect(router->error_socket >= 0, "error socket");
+    addr.sin_port = htons(ERROR_PORT);
+    expect(connect(router->error_socket, (struct sockaddr *) &addr, sizeof(addr)) >= 0, "error port connect");
 
-        uint8_t byte = i;
-        expect(send(sock, &byte, sizeof(uint8_t), 0) == sizeof(uint8_t), "link ID byte send");
+    // Each link thread connects its own link, so links come up in parallel.
+    for(int i = 0; i < router->link_count; i++) {
+        router_link_t *router_link = &router->links[i];
+        if(netsim_unix) snprintf(router_link->address, sizeof(router_link->address), NETSIM_SOCKET_FORMAT, netsim_address, i);
+        else snprintf(router_link->address, sizeof(router_link->address), "%s:%d", netsim_address, BASE_LINK_PORT + i);
+        router_link->transport_ops = netsim_unix ? &transport_unix : &transport_tcp;
 
-        link_sockets[i] = sock;
-        expect(pthread_create(&threads[i], &attr, link_handler, (void *) (long) i) == 0, "thread create");
-        links_yet_inactive -= 1;
+        link_start(router, i, attr);
     }
+}
 
+/**
+ * Waits for the network simulation to finish with a router, then ends its application link.
+ * Return Value - Non-zero if the network simulation reported an error.
+ */
+long router_finish(router_instance_t *router) {
     long has_error_occured = 0;
-    for(int i = NETSIM_LINK_BEGIN; i <= NETSIM_LINK_END; i++) {
+    for(int i = 0; i < router->link_count; i++) {
         void *retval;
-        pthread_join(threads[i], &retval);
+        pthread_join(router->links[i].thread, &retval);
         has_error_occured |= (long) retval;
     }
 
+    // No packets arrive anymore, so neither should timers change the table.
+    pthread_mutex_lock(&router->timer_mutex);
+    router->is_timer_stopping = 1;
+    pthread_cond_signal(&router->timer_cond);
+    pthread_mutex_unlock(&router->timer_mutex);
+    pthread_join(router->timer_thread, NULL);
+
     // Send termination packet to app.
     packet_t pkt = {};
     pkt.length = HEADER_SIZE;
@@ -364,10 +1220,223 @@ int main(const int argc, const char *argv[]) {
         buf[6] -= (1 << 5); // Update checksum
     }
 
-    expect(send(link_sockets[APP_LINK], buf, pkt.length, 0) == pkt.length, "ERR/END packet app send");
-    pthread_join(threads[APP_LINK], NULL);
+    expect(transport_send(&router->links[APP_LINK(router)].transport, buf, pkt.length) == 0, "ERR/END packet app send");
+    pthread_join(router->links[APP_LINK(router)].thread, NULL);
+
+    return has_error_occured;
+}
+
+/**
+ * Applies the link weights of a reloaded config to a running router.
+ * Anything else a config sets needs a restart, so a router whose address or links changed is left as it is.
+ */
+static void router_reload(router_instance_t *router, const router_config_t *config) {
+    void route_link_weight_changed(router_instance_t *router, const uint8_t link, const uint8_t weight);
 
-    print_results();
+    int is_same_router = config->address == router->address && config->link_count == router->link_count;
+    for(int i = 0; i < router->link_count && is_same_router; i++) {
+        is_same_router = config->links[i].neighbour_subnet == router->links[i].neighbour_subnet;
+    }
+    if(!is_same_router) {
+        warn("Router %u: reloaded config changes more than link weights, restart to apply it\n", router->address);
+        return;
+    }
+
+    for(int i = 0; i < router->link_count; i++) {
+        router_link_t *router_link = &router->links[i];
+        const uint8_t weight = config->links[i].weight;
+        if(weight == router_link->configured_weight) continue;
+
+        print("[*] Router %u: link %d configured weight %u -> %u\n", router->address, i, router_link->configured_weight, weight);
+        router_link->configured_weight = weight;
+
+        // The state file only warm starts a router whose configured weights match those of its last run.
+        state_header_t *header = router->data.state_file.header;
+        if(header) header->link_weights[i] = weight;
+
+        route_link_weight_changed(router, i, weight);
+    }
+}
+
+/**
+ * Reloads the config file every time the process receives `SIGHUP`, until the routers finish.
+ * `SIGHUP` is blocked in every thread, this one takes it with `sigwait()`.
+ */
+void *reload_handler(void *_context) {
+    reload_context_t *context = _context;
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGHUP);
+
+    while(1) {
+        int signal;
+        if(sigwait(&signals, &signal) != 0) continue;
+        if(atomic_load(&context->is_stopping)) break;
+
+        config_t config;
+        if(config_load(&config, context->path) != 0) {
+            warn("Config reload failed, the running config is kept\n");
+            continue;
+        }
+
+        if(config.router_count != context->router_count) {
+            warn("Reloaded config has %u routers instead of %u, restart to apply it\n", config.router_count, context->router_count);
+        }
+        else {
+            for(uint32_t i = 0; i < config.router_count; i++) {
+                router_reload(&context->routers[i], &config.routers[i]);
+            }
+        }
+        config_free(&config);
+    }
+
+    return NULL;
+}
+
+/**
+ * Loads the routers to run from the command line:
+ * either `-c <config file>`, or one network simulation address per router with the default topology.
+ * Return Value - 0 on success, else -1.
+ */
+int config_from_args(config_t *config, const int argc, const char *argv[]) {
+    if(argc == 3 && strcmp(argv[1], "-c") == 0) {
+        return config_load(config, argv[2]);
+    }
+
+    char *text = NULL;
+    size_t text_size = 0;
+    FILE *file = open_memstream(&text, &text_size);
+    if(!file) return -1;
+    for(int i = 1; i < argc; i++) {
+        fprintf(file, DEFAULT_CONFIG_FORMAT, argv[i]);
+    }
+    fclose(file);
+
+    file = fmemopen(text, text_size, "r");
+    const int status = file ? config_parse(config, file, "default config") : -1;
+    if(file) fclose(file);
+    free(text);
+    return status;
+}
+
+int main(const int argc, const char *argv[]) {
+    if(argc < 2) {
+        error("Expecting either `-c <config file>`, or the network simulation's IP address (one per router)\n");
+        return 1;
+    }
+
+    config_t config;
+    if(config_from_args(&config, argc, argv) != 0) {
+        error("Invalid router configuration\n");
+        return 1;
+    }
+
+    // Test Packet parsing
+    int test_packet_parsing(void);
+    if(test_packet_parsing() == 0) {
+        print("\n");
+        error("Packet parsing is incorrect\n");
+        return 1;
+    }
+    else {
+        print("\n");
+        no_error("All packet parsing tests passed\n");
+    }
+    print("\n");
+
+    // Test the routing table
+    int test_lpm(void);
+    if(test_lpm() == 0) {
+        print("\n");
+        error("Longest prefix match is incorrect\n");
+        return 1;
+    }
+    else {
+        print("\n");
+        no_error("All longest prefix match tests passed\n");
+    }
+    print("\n");
+
+    // Test the timers
+    int test_timer_wheel(void);
+    if(test_timer_wheel() == 0) {
+        print("\n");
+        error("Timer wheel is incorrect\n");
+        return 1;
+    }
+    else {
+        print("\n");
+        no_error("All timer wheel tests passed\n");
+    }
+    print("\n");
+
+    // Test the helpers of `route()`
+    int test_route_helpers(void);
+    if(test_route_helpers() == 0) {
+        print("\n");
+        error("Route helpers are incorrect\n");
+        return 1;
+    }
+    else {
+        print("\n");
+        no_error("All route helper tests passed\n");
+    }
+    print("\n");
+
+    FILE *log_file = fopen("log/router_log", "ab");
+    if(!log_file) {
+        perror("log file open");
+        return 1;
+    }
+    log_begin(log_file);
+
+    const uint32_t router_count = config.router_count;
+    router_instance_t *routers = calloc(router_count, sizeof(router_instance_t));
+    expect(routers, "router allocation");
+
+    pthread_attr_t attr;
+    expect(pthread_attr_init(&attr) == 0, "thread attribute init");
+    expect(pthread_attr_setstacksize(&attr, LINK_THREAD_STACK_SIZE) == 0, "thread stack size");
+
+    // Link weights from a config file can be changed at runtime: edit the file, then send the process `SIGHUP`.
+    // Threads inherit the blocked signal, so only the reload thread takes it.
+    reload_context_t reload = {};
+    reload.path = argc == 3 && strcmp(argv[1], "-c") == 0 ? argv[2] : NULL;
+    reload.routers = routers;
+    reload.router_count = router_count;
+    atomic_init(&reload.is_stopping, 0);
+    if(reload.path) {
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGHUP);
+        expect(pthread_sigmask(SIG_BLOCK, &signals, NULL) == 0, "signal mask");
+    }
+
+    for(uint32_t i = 0; i < router_count; i++) {
+        router_init(&routers[i], i, &config.routers[i]);
+        router_start(&routers[i], &attr);
+    }
+
+    // Only once every router is set up: a `SIGHUP` sent before stays pending until `sigwait()` takes it.
+    if(reload.path) {
+        expect(pthread_create(&reload.thread, NULL, reload_handler, &reload) == 0, "thread create");
+    }
+
+    long has_error_occured = 0;
+    for(uint32_t i = 0; i < router_count; i++) {
+        has_error_occured |= router_finish(&routers[i]);
+    }
+
+    if(reload.path) {
+        atomic_store(&reload.is_stopping, 1);
+        pthread_kill(reload.thread, SIGHUP);
+        pthread_join(reload.thread, NULL);
+    }
+
+    for(uint32_t i = 0; i < router_count; i++) {
+        print_results(&routers[i], router_count);
+    }
     print("\n");
     if(has_error_occured) {
         error("Routing is incorrect\n");
@@ -377,15 +1446,16 @@ int main(const int argc, const char *argv[]) {
     }
     print("\n");
 
-    // Close all sockets.
-    close(error_socket);
-    for(int i = 0; i < TOTAL_LINK_COUNT; i++) {
-        close(link_sockets[i]);
+    // Close all links.
+    for(uint32_t i = 0; i < router_count; i++) {
+        router_destroy(&routers[i]);
     }
+    free(routers);
+    config_free(&config);
 
     log_end();
 
     print("[*] Router ended\n");
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,227 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "include/shm_link.h"
+
+//=====================================
+//      CONSTANTS
+//=====================================
+
+// Order of the file descriptors passed over the unix socket.
+#define SHM_FD_REGION 0
+#define SHM_FD_TO_APP_EVENT 1
+#define SHM_FD_TO_ROUTER_EVENT 2
+#define SHM_FD_COUNT 3
+
+//=====================================
+//      HELPERS
+//=====================================
+
+static void ring_wake(const int event_fd) {
+    const uint64_t one = 1;
+    if(write(event_fd, &one, sizeof(one)) != sizeof(one)) return;
+}
+
+/**
+ * Return Value - 1 if the peer closed its end of the handover socket, waiting up to `timeout_ms` for it.
+ */
+static int peer_is_gone(const shm_link_t *link, const int timeout_ms) {
+    struct pollfd peer = { link->peer_sock, POLLIN | POLLRDHUP, 0 };
+    return poll(&peer, 1, timeout_ms) > 0;
+}
+
+static int link_map(shm_link_t *link) {
+    void *region = mmap(NULL, sizeof(shm_link_region_t), PROT_READ | PROT_WRITE, MAP_SHARED, link->memfd, 0);
+    if(region == MAP_FAILED) return -1;
+
+    link->region = region;
+    return pthread_mutex_init(&link->tx_lock, NULL) == 0 ? 0 : -1;
+}
+
+//=====================================
+//      FUNCTIONS
+//=====================================
+
+void shm_link_init(shm_link_t *link) {
+    memset(link, 0, sizeof(*link));
+    link->memfd = -1;
+    link->tx_event = -1;
+    link->rx_event = -1;
+    link->peer_sock = -1;
+}
+
+int shm_link_create(shm_link_t *link) {
+    shm_link_init(link);
+
+    link->memfd = memfd_create("rani_app_link", MFD_CLOEXEC);
+    if(link->memfd < 0) return -1;
+    if(ftruncate(link->memfd, sizeof(shm_link_region_t)) != 0) return -1;
+    if(link_map(link) != 0) return -1;
+
+    // A fresh memfd is zero filled, so both rings start out empty.
+    link->tx = &link->region->to_router;
+    link->rx = &link->region->to_app;
+
+    link->tx_event = eventfd(0, EFD_CLOEXEC);
+    link->rx_event = eventfd(0, EFD_CLOEXEC);
+    if(link->tx_event < 0 || link->rx_event < 0) return -1;
+
+    return 0;
+}
+
+int shm_link_share(const shm_link_t *link, const int sock) {
+    int fds[SHM_FD_COUNT];
+    fds[SHM_FD_REGION] = link->memfd;
+    fds[SHM_FD_TO_APP_EVENT] = link->rx_event;
+    fds[SHM_FD_TO_ROUTER_EVENT] = link->tx_event;
+
+    union {
+        char buf[CMSG_SPACE(sizeof(fds))];
+        struct cmsghdr align;
+    } control = {};
+
+    uint8_t byte = 0;
+    struct iovec iov = { &byte, sizeof(byte) };
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    return sendmsg(sock, &msg, 0) == sizeof(byte) ? 0 : -1;
+}
+
+int shm_link_attach(shm_link_t *link, const int sock) {
+    shm_link_init(link);
+
+    int fds[SHM_FD_COUNT];
+    union {
+        char buf[CMSG_SPACE(sizeof(fds))];
+        struct cmsghdr align;
+    } control = {};
+
+    uint8_t byte = 0;
+    struct iovec iov = { &byte, sizeof(byte) };
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    if(recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != sizeof(byte)) return -1;
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if(!cmsg || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(fds))) return -1;
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+    link->memfd = fds[SHM_FD_REGION];
+    link->tx_event = fds[SHM_FD_TO_APP_EVENT];
+    link->rx_event = fds[SHM_FD_TO_ROUTER_EVENT];
+    if(link_map(link) != 0) return -1;
+
+    link->tx = &link->region->to_app;
+    link->rx = &link->region->to_router;
+
+    return 0;
+}
+
+int shm_link_send(shm_link_t *link, const uint8_t *buf, const uint8_t size) {
+    shm_ring_t *ring = link->tx;
+
+    pthread_mutex_lock(&link->tx_lock);
+
+    // A consumer that went away never drains the ring, so the peer is checked on now and then.
+    const uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    for(uint32_t spins = 1; tail - atomic_load_explicit(&ring->head, memory_order_acquire) == SHM_RING_SLOTS; spins++) {
+        if(spins % SHM_PEER_CHECK_SPINS == 0 && peer_is_gone(link, 0)) {
+            pthread_mutex_unlock(&link->tx_lock);
+            return -1;
+        }
+        sched_yield();
+    }
+
+    shm_slot_t *slot = &ring->slots[tail & (SHM_RING_SLOTS - 1)];
+    slot->size = size;
+    memcpy(slot->data, buf, size);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+
+    // Pairs with the fence in `shm_link_recv()`: either the consumer sees the new tail, or we see it waiting.
+    atomic_thread_fence(memory_order_seq_cst);
+    if(atomic_load_explicit(&ring->consumer_waiting, memory_order_relaxed)) {
+        ring_wake(link->tx_event);
+    }
+
+    pthread_mutex_unlock(&link->tx_lock);
+    return 0;
+}
+
+static ssize_t ring_pop(shm_ring_t *ring, const uint32_t head, uint8_t *buf, const size_t size) {
+    const shm_slot_t *slot = &ring->slots[head & (SHM_RING_SLOTS - 1)];
+    const size_t copy_size = slot->size < size ? slot->size : size;
+    memcpy(buf, slot->data, copy_size);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    return (ssize_t) copy_size;
+}
+
+ssize_t shm_link_try_recv(shm_link_t *link, uint8_t *buf, const size_t size) {
+    shm_ring_t *ring = link->rx;
+    const uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    if(atomic_load_explicit(&ring->tail, memory_order_acquire) == head) return 0;
+    return ring_pop(ring, head, buf, size);
+}
+
+ssize_t shm_link_recv(shm_link_t *link, uint8_t *buf, const size_t size) {
+    shm_ring_t *ring = link->rx;
+    const uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    while(atomic_load_explicit(&ring->tail, memory_order_acquire) == head) {
+        atomic_store_explicit(&ring->consumer_waiting, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+
+        // Waits on the eventfd and the handover socket together, so a peer that went away wakes us too.
+        int is_peer_gone = 0;
+        if(atomic_load_explicit(&ring->tail, memory_order_acquire) == head) {
+            struct pollfd fds[2] = { { link->rx_event, POLLIN, 0 }, { link->peer_sock, POLLIN | POLLRDHUP, 0 } };
+            if(poll(fds, 2, -1) < 0 && errno != EINTR) return -1;
+
+            uint64_t count;
+            if((fds[0].revents & POLLIN) && read(link->rx_event, &count, sizeof(count)) != sizeof(count)) return -1;
+            is_peer_gone = fds[1].revents != 0;
+        }
+
+        atomic_store_explicit(&ring->consumer_waiting, 0, memory_order_relaxed);
+
+        // Packets pushed before the peer went away are still handed out.
+        if(is_peer_gone && atomic_load_explicit(&ring->tail, memory_order_acquire) == head) return -1;
+    }
+
+    return ring_pop(ring, head, buf, size);
+}
+
+void shm_link_close(shm_link_t *link) {
+    // The lock is only set up once the region is mapped.
+    if(link->region) {
+        munmap(link->region, sizeof(shm_link_region_t));
+        pthread_mutex_destroy(&link->tx_lock);
+    }
+    if(link->memfd >= 0) close(link->memfd);
+    if(link->tx_event >= 0) close(link->tx_event);
+    if(link->rx_event >= 0) close(link->rx_event);
+    if(link->peer_sock >= 0) close(link->peer_sock);
+    shm_link_init(link);
+}
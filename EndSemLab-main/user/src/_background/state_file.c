@@ -0,0 +1,87 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "include/state_file.h"
+
+//=====================================
+//      HELPERS
+//=====================================
+
+static int header_matches(const state_header_t *header, const state_header_t *expected) {
+    return header->magic == STATE_FILE_MAGIC &&
+        header->version == STATE_FILE_VERSION &&
+        header->address == expected->address &&
+        header->address_bits == expected->address_bits &&
+        header->link_count == expected->link_count &&
+        header->entry_capacity == expected->entry_capacity &&
+        header->entry_end <= header->entry_capacity &&
+        memcmp(header->link_weights, expected->link_weights, sizeof(header->link_weights)) == 0;
+}
+
+//=====================================
+//      FUNCTIONS
+//=====================================
+
+int state_file_open(state_file_t *file, const char *path, const state_header_t *expected) {
+    memset(file, 0, sizeof(*file));
+    file->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if(file->fd < 0) return -1;
+
+    // Records are only touched once their entry is, so the file stays sparse however wide the addresses.
+    file->size = sizeof(state_header_t) + sizeof(state_entry_t) * (size_t) expected->entry_capacity;
+
+    struct stat stat;
+    const int is_sized = fstat(file->fd, &stat) == 0 && (size_t) stat.st_size == file->size;
+    if(!is_sized && ftruncate(file->fd, file->size) != 0) goto fail;
+
+    file->header = mmap(NULL, file->size, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, 0);
+    if(file->header == MAP_FAILED) {
+        file->header = NULL;
+        goto fail;
+    }
+    file->entries = (state_entry_t *) (file->header + 1);
+
+    if(is_sized && header_matches(file->header, expected)) return 1;
+
+    // The header of a file being cleared cannot be trusted: keep the records cleared within the mapping.
+    if(file->header->entry_end > expected->entry_capacity) file->header->entry_end = expected->entry_capacity;
+    state_file_clear(file);
+    memcpy(file->header, expected, sizeof(*file->header));
+    file->header->magic = STATE_FILE_MAGIC;
+    file->header->version = STATE_FILE_VERSION;
+    file->header->entry_end = 0;
+    memset(file->header->link_timestamps, 0, sizeof(file->header->link_timestamps));
+    return 0;
+
+fail:
+    state_file_close(file);
+    return -1;
+}
+
+void state_file_set(state_file_t *file, const uint32_t index, const state_entry_t *entry) {
+    if(!file->header || index >= file->header->entry_capacity) return;
+
+    file->entries[index] = *entry;
+    if(index >= file->header->entry_end) file->header->entry_end = index + 1;
+}
+
+void state_file_clear(state_file_t *file) {
+    if(!file->header) return;
+
+    memset(file->entries, 0, sizeof(state_entry_t) * file->header->entry_end);
+    file->header->entry_end = 0;
+}
+
+void state_file_close(state_file_t *file) {
+    if(file->header) {
+        msync(file->header, file->size, MS_SYNC);
+        munmap(file->header, file->size);
+    }
+    if(file->fd >= 0) close(file->fd);
+
+    memset(file, 0, sizeof(*file));
+    file->fd = -1;
+}
@@ -0,0 +1,136 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "include/stats.h"
+
+//=====================================
+//      THREAD STATE
+//=====================================
+
+// Set by `stats_bind_thread()`.
+static __thread stats_t *thread_stats;
+static __thread stats_counters_t *thread_row;
+static __thread uint8_t thread_link;
+
+//=====================================
+//      HELPERS
+//=====================================
+
+static inline uint32_t row_width(const stats_t *stats) {
+    return stats->header->link_count + 1;
+}
+
+/**
+ * The counters of the calling thread for `link`, or those of the shared row if the thread has no row of `stats`.
+ * `is_shared` - Set if the counters are shared, and must be added to atomically.
+ */
+static stats_counters_t *row_of(stats_t *stats, const uint8_t link, int *is_shared) {
+    *is_shared = thread_stats != stats;
+    if(!*is_shared) return &thread_row[link];
+
+    const uint32_t shared_row = stats->header->thread_count - 1;
+    return &stats->counters[shared_row * row_width(stats) + link];
+}
+
+/**
+ * Rows of their own have a single writer, so a plain load and store is enough and no bus lock is taken.
+ */
+static inline void counter_add(_Atomic uint64_t *counter, const uint64_t value, const int is_shared) {
+    if(is_shared) atomic_fetch_add_explicit(counter, value, memory_order_relaxed);
+    else atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+//=====================================
+//      FUNCTIONS
+//=====================================
+
+int stats_open(stats_t *stats, const char *name, const uint8_t address, const uint8_t link_count, const uint16_t thread_count) {
+    memset(stats, 0, sizeof(*stats));
+    stats->fd = -1;
+    if(thread_count == 0 || strlen(name) > STATS_NAME_MAX) return -1;
+
+    const size_t counter_count = (size_t) thread_count * (link_count + 1);
+    // The header takes the first cache line, so the counters after it stay aligned.
+    _Static_assert(sizeof(stats_header_t) <= STATS_CACHE_LINE_SIZE, "stats header must fit a cache line");
+    stats->size = STATS_CACHE_LINE_SIZE + sizeof(stats_counters_t) * counter_count;
+
+    void *region;
+    if(name[0]) {
+        snprintf(stats->shm_name, sizeof(stats->shm_name), "/" STATS_SHM_PREFIX "%s", name);
+        shm_unlink(stats->shm_name);
+        stats->fd = shm_open(stats->shm_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+        if(stats->fd < 0 || ftruncate(stats->fd, stats->size) != 0) goto fail;
+        region = mmap(NULL, stats->size, PROT_READ | PROT_WRITE, MAP_SHARED, stats->fd, 0);
+    }
+    else {
+        region = mmap(NULL, stats->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if(region == MAP_FAILED) goto fail;
+
+    // Fresh mappings are zero filled. The magic is written last, so a reader never sees a half made header.
+    stats->header = region;
+    stats->counters = (stats_counters_t *) ((uint8_t *) region + STATS_CACHE_LINE_SIZE);
+    stats->header->version = STATS_VERSION;
+    stats->header->address = address;
+    stats->header->link_count = link_count;
+    stats->header->thread_count = thread_count;
+    atomic_thread_fence(memory_order_release);
+    stats->header->magic = STATS_MAGIC;
+    return 0;
+
+fail:
+    stats_close(stats);
+    return -1;
+}
+
+void stats_close(stats_t *stats) {
+    if(stats->header) {
+        atomic_store(&stats->header->is_closed, 1);
+        munmap(stats->header, stats->size);
+    }
+    if(stats->fd >= 0) close(stats->fd);
+    if(stats->shm_name[0]) shm_unlink(stats->shm_name);
+
+    memset(stats, 0, sizeof(*stats));
+    stats->fd = -1;
+}
+
+void stats_bind_thread(stats_t *stats, const uint16_t row, const uint8_t link) {
+    if(!stats->header || row + 1 >= stats->header->thread_count) return;
+
+    thread_stats = stats;
+    thread_row = &stats->counters[row * row_width(stats)];
+    thread_link = link;
+}
+
+void stats_count_rx(stats_t *stats, const uint8_t link, const uint32_t packets, const uint64_t bytes) {
+    int is_shared;
+    stats_counters_t *counters = row_of(stats, link, &is_shared);
+    counter_add(&counters->rx_packets, packets, is_shared);
+    counter_add(&counters->rx_bytes, bytes, is_shared);
+}
+
+void stats_count_tx(stats_t *stats, const uint8_t link, const uint32_t packets, const uint64_t bytes) {
+    int is_shared;
+    stats_counters_t *counters = row_of(stats, link, &is_shared);
+    counter_add(&counters->tx_packets, packets, is_shared);
+    counter_add(&counters->tx_bytes, bytes, is_shared);
+}
+
+void stats_count_broadcast(stats_t *stats, const uint8_t link, const uint64_t bytes) {
+    int is_shared;
+    stats_counters_t *counters = row_of(stats, link, &is_shared);
+    counter_add(&counters->tx_packets, 1, is_shared);
+    counter_add(&counters->tx_bytes, bytes, is_shared);
+    counter_add(&counters->broadcasts, 1, is_shared);
+}
+
+void stats_count_drop(const uint8_t drop_code) {
+    if(!thread_stats) return;
+
+    const uint32_t index = (uint32_t) (drop_code - STATS_DROP_CODE_FIRST);
+    counter_add(&thread_row[thread_link].drops[index < STATS_DROP_CODE_COUNT ? index : 0], 1, 0);
+}
@@ -0,0 +1,203 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "include/stats.h"
+
+#define DEFAULT_INTERVAL_MS 1000
+
+// Indexed by drop code, from `STATS_DROP_CODE_FIRST`.
+static const char *DROP_NAMES[STATS_DROP_CODE_COUNT] = {
+    "general",
+    "checksum_error",
+    "ttl_zero",
+    "no_routing_entry",
+    "outdated_command",
+    "too_large",
+    "rate_limited",
+    "duplicate",
+};
+
+// Sum of a link's counters over some rows, as read at one time.
+typedef struct totals {
+    uint64_t rx_packets;
+    uint64_t rx_bytes;
+    uint64_t tx_packets;
+    uint64_t tx_bytes;
+    uint64_t broadcasts;
+    uint64_t drops[STATS_DROP_CODE_COUNT];
+} totals_t;
+
+void usage(void) {
+    printf("USAGE:\n");
+    printf("    ./stats [-t] <name> [interval ms]\n");
+    printf("Prints the rates of the counters a router publishes with `stats <name>` in its config.\n");
+    printf("    -t    Also prints the rates of each thread.\n");
+}
+
+static double now_s(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void totals_add(totals_t *totals, const stats_counters_t *counters) {
+    totals->rx_packets += atomic_load_explicit(&counters->rx_packets, memory_order_relaxed);
+    totals->rx_bytes += atomic_load_explicit(&counters->rx_bytes, memory_order_relaxed);
+    totals->tx_packets += atomic_load_explicit(&counters->tx_packets, memory_order_relaxed);
+    totals->tx_bytes += atomic_load_explicit(&counters->tx_bytes, memory_order_relaxed);
+    totals->broadcasts += atomic_load_explicit(&counters->broadcasts, memory_order_relaxed);
+    for(int i = 0; i < STATS_DROP_CODE_COUNT; i++) {
+        totals->drops[i] += atomic_load_explicit(&counters->drops[i], memory_order_relaxed);
+    }
+}
+
+static void totals_merge(totals_t *totals, const totals_t *other) {
+    totals->rx_packets += other->rx_packets;
+    totals->rx_bytes += other->rx_bytes;
+    totals->tx_packets += other->tx_packets;
+    totals->tx_bytes += other->tx_bytes;
+    totals->broadcasts += other->broadcasts;
+    for(int i = 0; i < STATS_DROP_CODE_COUNT; i++) {
+        totals->drops[i] += other->drops[i];
+    }
+}
+
+static uint64_t totals_drops(const totals_t *totals) {
+    uint64_t drops = 0;
+    for(int i = 0; i < STATS_DROP_CODE_COUNT; i++) {
+        drops += totals->drops[i];
+    }
+    return drops;
+}
+
+static void print_rates(const char *what, const totals_t *now, const totals_t *before, const double seconds) {
+    printf("%-10s %10.0f %12.0f %10.0f %12.0f %10.0f %10.0f\n", what,
+        (now->rx_packets - before->rx_packets) / seconds,
+        (now->rx_bytes - before->rx_bytes) / seconds,
+        (now->tx_packets - before->tx_packets) / seconds,
+        (now->tx_bytes - before->tx_bytes) / seconds,
+        (now->broadcasts - before->broadcasts) / seconds,
+        (totals_drops(now) - totals_drops(before)) / seconds);
+}
+
+int main(const int argc, const char *argv[]) {
+    int arg = 1;
+    const int per_thread = argc > arg && strcmp(argv[arg], "-t") == 0;
+    if(per_thread) arg += 1;
+    if(argc - arg < 1 || argc - arg > 2) {
+        usage();
+        return 1;
+    }
+
+    const int interval_ms = argc - arg == 2 ? atoi(argv[arg + 1]) : DEFAULT_INTERVAL_MS;
+    if(interval_ms <= 0) {
+        usage();
+        return 1;
+    }
+
+    char shm_name[sizeof(STATS_SHM_PREFIX) + STATS_NAME_MAX + 1];
+    snprintf(shm_name, sizeof(shm_name), "/" STATS_SHM_PREFIX "%s", argv[arg]);
+    const int fd = shm_open(shm_name, O_RDONLY, 0);
+    if(fd < 0) {
+        perror("stats open failed (is the router running?)");
+        return 1;
+    }
+
+    struct stat stat;
+    if(fstat(fd, &stat) != 0 || (size_t) stat.st_size < STATS_CACHE_LINE_SIZE) {
+        fprintf(stderr, "stats segment is not ready\n");
+        return 1;
+    }
+    const size_t size = stat.st_size;
+    const uint8_t *region = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(region == MAP_FAILED) {
+        perror("stats map failed");
+        return 1;
+    }
+
+    const stats_header_t *header = (const stats_header_t *) region;
+    const stats_counters_t *counters = (const stats_counters_t *) (region + STATS_CACHE_LINE_SIZE);
+    const uint32_t width = header->link_count + 1;
+    const uint32_t rows = header->thread_count;
+    if(header->magic != STATS_MAGIC || header->version != STATS_VERSION ||
+        size < STATS_CACHE_LINE_SIZE + sizeof(stats_counters_t) * width * rows) {
+        fprintf(stderr, "stats segment is not from a matching router\n");
+        return 1;
+    }
+
+    // Per link (summed over threads) then per thread (summed over links), for the last two reads.
+    totals_t *totals[2];
+    for(int i = 0; i < 2; i++) {
+        totals[i] = calloc(width + rows, sizeof(totals_t));
+        if(!totals[i]) {
+            perror("allocation failed");
+            return 1;
+        }
+    }
+
+    double read_s = 0;
+    for(int round = 0; !atomic_load(&header->is_closed); round++) {
+        totals_t *now = totals[round & 1];
+        totals_t *before = totals[(round & 1) ^ 1];
+        memset(now, 0, sizeof(totals_t) * (width + rows));
+
+        const double seconds = now_s() - read_s;
+        read_s += seconds;
+        for(uint32_t row = 0; row < rows; row++) {
+            for(uint32_t link = 0; link < width; link++) {
+                totals_add(&now[link], &counters[row * width + link]);
+                totals_add(&now[width + row], &counters[row * width + link]);
+            }
+        }
+
+        if(round > 0) {
+            printf("\n==== Router %u (%s, per second) ====\n", header->address, argv[arg]);
+            printf("%-10s %10s %12s %10s %12s %10s %10s\n", "link", "rx pkts", "rx bytes", "tx pkts", "tx bytes", "bcasts", "drops");
+
+            totals_t all = {};
+            totals_t all_before = {};
+            char what[32];
+            for(uint32_t link = 0; link < width; link++) {
+                if(link + 1 == width) snprintf(what, sizeof(what), "app");
+                else snprintf(what, sizeof(what), "%u", link);
+                print_rates(what, &now[link], &before[link], seconds);
+
+                totals_merge(&all, &now[link]);
+                totals_merge(&all_before, &before[link]);
+            }
+            print_rates("total", &all, &all_before, seconds);
+
+            if(per_thread) {
+                // Link threads come first, then the timer thread, then the row shared by any other thread.
+                for(uint32_t row = 0; row < rows; row++) {
+                    if(row + 2 == rows) snprintf(what, sizeof(what), "timer");
+                    else if(row + 1 == rows) snprintf(what, sizeof(what), "other");
+                    else if(row + 3 == rows) snprintf(what, sizeof(what), "thread app");
+                    else snprintf(what, sizeof(what), "thread %u", row);
+                    print_rates(what, &now[width + row], &before[width + row], seconds);
+                }
+            }
+
+            printf("drops:");
+            for(int i = 0; i < STATS_DROP_CODE_COUNT; i++) {
+                const uint64_t drops = all.drops[i] - all_before.drops[i];
+                if(drops) printf(" %s %.0f", DROP_NAMES[i], drops / seconds);
+            }
+            printf("\n");
+            fflush(stdout);
+        }
+
+        usleep(interval_ms * 1000);
+    }
+
+    printf("\n[*] Router %u closed its counters\n", header->address);
+    munmap((void *) region, size);
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include <stddef.h>
+#include <stdint.h>
+#include "include/timer_wheel.h"
+
+//=====================================
+//      HELPERS
+//=====================================
+
+static inline void list_append(router_timer_t *list, router_timer_t *timer) {
+    timer->prev = list->prev;
+    timer->next = list;
+    list->prev->next = timer;
+    list->prev = timer;
+}
+
+/**
+ * Moves every timer of `from` to the end of `to`.
+ * Return Value - The number of timers moved.
+ */
+static uint32_t list_splice(router_timer_t *from, router_timer_t *to) {
+    uint32_t count = 0;
+    while(from->next != from) {
+        router_timer_t *timer = from->next;
+        timer_wheel_remove(timer);
+        list_append(to, timer);
+        count += 1;
+    }
+    return count;
+}
+
+//=====================================
+//      FUNCTIONS
+//=====================================
+
+void timer_list_init(router_timer_t *list) {
+    list->next = list;
+    list->prev = list;
+}
+
+void timer_wheel_init(timer_wheel_t *wheel, const uint64_t now) {
+    wheel->now = now;
+    for(int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for(int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            timer_list_init(&wheel->slots[level][slot]);
+        }
+    }
+}
+
+void timer_wheel_add(timer_wheel_t *wheel, router_timer_t *timer, uint64_t expires) {
+    if(expires <= wheel->now) expires = wheel->now + 1;
+    if(expires - wheel->now > TIMER_WHEEL_MAX_DELAY) expires = wheel->now + TIMER_WHEEL_MAX_DELAY;
+    timer->expires = expires;
+
+    const uint64_t delay = expires - wheel->now;
+    int level = 0;
+    while(level < TIMER_WHEEL_LEVELS - 1 && delay >> ((level + 1) * TIMER_WHEEL_SLOT_BITS)) {
+        level += 1;
+    }
+
+    const uint32_t slot = (expires >> (level * TIMER_WHEEL_SLOT_BITS)) & (TIMER_WHEEL_SLOTS - 1);
+    list_append(&wheel->slots[level][slot], timer);
+}
+
+void timer_wheel_remove(router_timer_t *timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->next = NULL;
+    timer->prev = NULL;
+}
+
+uint64_t timer_wheel_next_tick(const timer_wheel_t *wheel) {
+    uint64_t next = UINT64_MAX;
+    for(int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        // Slot `s` of a level is turned on the multiples of the level's span whose index in the level is `s`.
+        const uint32_t shift = level * TIMER_WHEEL_SLOT_BITS;
+        const uint64_t first = (wheel->now >> shift) + 1;
+        for(uint32_t slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            const router_timer_t *list = &wheel->slots[level][slot];
+            if(list->next == list) continue;
+
+            const uint64_t tick = (first + ((slot - first) & (TIMER_WHEEL_SLOTS - 1))) << shift;
+            if(tick < next) next = tick;
+        }
+    }
+    return next;
+}
+
+uint32_t timer_wheel_advance(timer_wheel_t *wheel, const uint64_t now, router_timer_t *expired) {
+    uint32_t count = 0;
+    while(wheel->now < now) {
+        wheel->now += 1;
+
+        // Each time a level wraps around, the next slot of the level above is spread over the levels below.
+        for(int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+            if(wheel->now & ((UINT64_C(1) << (level * TIMER_WHEEL_SLOT_BITS)) - 1)) break;
+
+            router_timer_t cascade;
+            timer_list_init(&cascade);
+            list_splice(&wheel->slots[level][(wheel->now >> (level * TIMER_WHEEL_SLOT_BITS)) & (TIMER_WHEEL_SLOTS - 1)], &cascade);
+            while(cascade.next != &cascade) {
+                router_timer_t *timer = cascade.next;
+                timer_wheel_remove(timer);
+                if(timer->expires > wheel->now) {
+                    timer_wheel_add(wheel, timer, timer->expires);
+                }
+                else {
+                    list_append(expired, timer);
+                    count += 1;
+                }
+            }
+        }
+
+        count += list_splice(&wheel->slots[0][wheel->now & (TIMER_WHEEL_SLOTS - 1)], expired);
+    }
+    return count;
+}
@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "../include/common.h"
+#include "include/timer_wheel.h"
+
+#define ANSI_COLOR_RED     "\x1b[31m"
+#define ANSI_COLOR_GREEN   "\x1b[32m"
+#define ANSI_COLOR_RESET   "\x1b[0m"
+
+//=====================================
+//      DATA
+//=====================================
+
+#define SPAN(level) (UINT64_C(1) << ((level) * TIMER_WHEEL_SLOT_BITS))
+
+// Delays on either side of the span of each level.
+static const uint64_t TEST_DELAYS[] = {
+    1, SPAN(1) - 1, SPAN(1), SPAN(1) + 1,
+    SPAN(2) - 1, SPAN(2), SPAN(2) + 1,
+    SPAN(3) - 1, SPAN(3), SPAN(3) + 1,
+};
+#define TEST_DELAY_COUNT (sizeof(TEST_DELAYS) / sizeof(TEST_DELAYS[0]))
+
+// Timers added at random, and the ticks they are added over, centred on a cascade of the top level.
+#define TEST_RANDOM_TIMER_COUNT 128
+#define TEST_RANDOM_TICKS (4 * SPAN(2))
+
+static int current_test_case, net_assertion;
+static uint32_t random_state;
+
+//=====================================
+//      FUNCTIONS
+//=====================================
+
+static inline void test_case(const int assertion, const char *msg) {
+    print(
+        "[*] Timer Wheel Test %d [%s]: %s\n",
+        current_test_case,
+        msg,
+        assertion ? ANSI_COLOR_GREEN "PASSED" ANSI_COLOR_RESET : ANSI_COLOR_RED "FAILED" ANSI_COLOR_RESET
+    );
+    net_assertion = net_assertion && assertion;
+    current_test_case += 1;
+}
+
+// Deterministic, so a failure can be replayed.
+static uint32_t test_random(void) {
+    random_state = random_state * UINT32_C(1664525) + UINT32_C(1013904223);
+    return random_state >> 8;
+}
+
+/**
+ * Turns the wheel to `now`, and takes the timers that expired off the list.
+ * `is_exact` - Every timer must be due at `now`, rather than at any of the ticks turned.
+ * Return Value - The number of timers that expired, or -1 if any of them was due at another tick.
+ */
+static int64_t advance_to(timer_wheel_t *wheel, const uint64_t now, const int is_exact) {
+    const uint64_t first = is_exact ? now : wheel->now + 1;
+    router_timer_t expired;
+    timer_list_init(&expired);
+    const uint32_t count = timer_wheel_advance(wheel, now, &expired);
+
+    int64_t retval = count;
+    while(expired.next != &expired) {
+        router_timer_t *timer = expired.next;
+        timer_wheel_remove(timer);
+        if(timer->expires < first || timer->expires > now) retval = -1;
+    }
+    return retval;
+}
+
+/**
+ * Adds a timer for each of `TEST_DELAYS` at `start`, then turns the wheel,
+ * checking each timer expires on the tick it was added for, across every cascade on the way.
+ * `is_sleeping` - Turns the wheel straight to `timer_wheel_next_tick()`, rather than a tick at a time.
+ */
+static int delays_expire_on_time(const uint64_t start, const int is_sleeping) {
+    timer_wheel_t wheel;
+    router_timer_t timers[TEST_DELAY_COUNT];
+    timer_wheel_init(&wheel, start);
+    for(size_t i = 0; i < TEST_DELAY_COUNT; i++) {
+        timer_wheel_add(&wheel, &timers[i], start + TEST_DELAYS[i]);
+    }
+
+    uint32_t expired = 0;
+    uint64_t now = start;
+    while(expired < TEST_DELAY_COUNT && now <= start + TEST_DELAYS[TEST_DELAY_COUNT - 1]) {
+        now = is_sleeping ? timer_wheel_next_tick(&wheel) : now + 1;
+        const int64_t count = advance_to(&wheel, now, 1);
+        if(count < 0) return 0;
+        expired += count;
+    }
+
+    for(size_t i = 0; i < TEST_DELAY_COUNT; i++) {
+        if(timer_wheel_is_pending(&timers[i])) return 0;
+    }
+    return expired == TEST_DELAY_COUNT && timer_wheel_next_tick(&wheel) == UINT64_MAX;
+}
+
+/**
+ * Adds and removes timers at random ticks while the wheel turns, checking removed timers never expire,
+ * the others expire on their tick, and `timer_wheel_next_tick()` never lies past any of them.
+ */
+static int random_timers_expire_on_time(void) {
+    timer_wheel_t wheel;
+    router_timer_t timers[TEST_RANDOM_TIMER_COUNT];
+    memset(timers, 0, sizeof(timers));
+    const uint64_t start = ((uint64_t) test_random() + 1) * SPAN(3) - TEST_RANDOM_TICKS / 2;
+    timer_wheel_init(&wheel, start);
+
+    for(uint64_t now = start + 1; now <= start + TEST_RANDOM_TICKS; now++) {
+        if(advance_to(&wheel, now, 1) < 0) return 0;
+
+        router_timer_t *timer = &timers[test_random() % TEST_RANDOM_TIMER_COUNT];
+        if(timer_wheel_is_pending(timer)) {
+            timer_wheel_remove(timer);
+        }
+        else {
+            // Mostly near delays, with some reaching the top level.
+            const uint32_t delay = test_random() & (SPAN(test_random() % TIMER_WHEEL_LEVELS + 1) - 1);
+            timer_wheel_add(&wheel, timer, now + delay);
+            if(timer->expires != now + (delay ? delay : 1)) return 0;
+        }
+
+        // The wheel is never left standing past a timer.
+        uint64_t first_expiry = UINT64_MAX;
+        for(int i = 0; i < TEST_RANDOM_TIMER_COUNT; i++) {
+            if(timer_wheel_is_pending(&timers[i]) && timers[i].expires < first_expiry) first_expiry = timers[i].expires;
+        }
+        const uint64_t next_tick = timer_wheel_next_tick(&wheel);
+        if(next_tick <= now || next_tick > first_expiry) return 0;
+    }
+
+    // Nothing is left behind in the wheel.
+    int is_ok = advance_to(&wheel, start + TEST_RANDOM_TICKS + TIMER_WHEEL_MAX_DELAY, 0) >= 0;
+    for(int i = 0; i < TEST_RANDOM_TIMER_COUNT; i++) {
+        is_ok = is_ok && !timer_wheel_is_pending(&timers[i]);
+    }
+    return is_ok;
+}
+
+// Returns 1 if all tests pass, else 0.
+int test_timer_wheel(void) {
+    timer_wheel_t wheel;
+    router_timer_t timer;
+    current_test_case = 1;
+    net_assertion = 1;
+    random_state = 1;
+
+    timer_wheel_init(&wheel, 1000);
+    timer_wheel_add(&wheel, &timer, 10);
+    test_case(timer.expires == 1001 && advance_to(&wheel, 1001, 1) == 1, "past tick expires on the next tick");
+
+    timer_wheel_add(&wheel, &timer, 1500);
+    timer_wheel_remove(&timer);
+    test_case(!timer_wheel_is_pending(&timer) && advance_to(&wheel, 2000, 0) == 0, "removed timer does not expire");
+
+    timer_wheel_add(&wheel, &timer, UINT64_MAX);
+    const uint64_t clamped = 2000 + TIMER_WHEEL_MAX_DELAY;
+    test_case(timer.expires == clamped && advance_to(&wheel, clamped - 1, 0) == 0 && advance_to(&wheel, clamped, 1) == 1,
+        "delay beyond the top level is clamped");
+
+    // Start just before each level wraps, so the delays cross cascades of every level.
+    const uint64_t starts[] = { 0, SPAN(1) - 3, SPAN(2) - 3, SPAN(3) - 3, SPAN(4) - 3, 7 * SPAN(4) + SPAN(3) + 5 };
+    for(size_t i = 0; i < sizeof(starts) / sizeof(starts[0]); i++) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "cascades from tick %llu", (unsigned long long) starts[i]);
+        test_case(delays_expire_on_time(starts[i], 0), msg);
+        snprintf(msg, sizeof(msg), "sleeping cascades from tick %llu", (unsigned long long) starts[i]);
+        test_case(delays_expire_on_time(starts[i], 1), msg);
+    }
+
+    test_case(random_timers_expire_on_time(), "random adds and removes");
+
+    return net_assertion;
+}
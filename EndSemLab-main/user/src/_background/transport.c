@@ -0,0 +1,86 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "include/transport.h"
+
+//=====================================
+//      DATA
+//=====================================
+
+static const transport_ops_t *const TRANSPORTS[] = {
+    &transport_tcp,
+    &transport_unix,
+    &transport_shm,
+};
+
+//=====================================
+//      FUNCTIONS
+//=====================================
+
+const transport_ops_t *transport_find(const char *name) {
+    for(size_t i = 0; i < sizeof(TRANSPORTS) / sizeof(TRANSPORTS[0]); i++) {
+        if(strcmp(TRANSPORTS[i]->name, name) == 0) return TRANSPORTS[i];
+    }
+    return NULL;
+}
+
+int transport_open(transport_t *transport, const transport_ops_t *ops, const char *address, const transport_role_t role, const uint8_t hello) {
+    memset(transport, 0, sizeof(*transport));
+    transport->ops = ops;
+    transport->fd = -1;
+    return ops->open(transport, address, role, hello);
+}
+
+int transport_send(transport_t *transport, const uint8_t *buf, const uint8_t size) {
+    transport_msg_t msg = { (uint8_t *) buf, size };
+    return transport->ops->send_batch(transport, &msg, 1) == 1 ? 0 : -1;
+}
+
+ssize_t transport_recv(transport_t *transport, uint8_t *buf) {
+    transport_msg_t msg = { buf, 0 };
+    const int count = transport->ops->recv_batch(transport, &msg, 1);
+    return count <= 0 ? count : msg.size;
+}
+
+void transport_close(transport_t *transport) {
+    if(transport->ops) transport->ops->close(transport);
+    memset(transport, 0, sizeof(*transport));
+    transport->fd = -1;
+}
+
+//=====================================
+//      SOCKET HELPERS
+//=====================================
+
+int transport_socket_send_batch(transport_t *transport, const transport_msg_t *msgs, const int count) {
+    struct mmsghdr headers[TRANSPORT_BATCH_MAX];
+    struct iovec iovs[TRANSPORT_BATCH_MAX];
+
+    int sent = 0;
+    while(sent < count) {
+        const int chunk = count - sent < TRANSPORT_BATCH_MAX ? count - sent : TRANSPORT_BATCH_MAX;
+        memset(headers, 0, sizeof(headers[0]) * chunk);
+        for(int i = 0; i < chunk; i++) {
+            iovs[i].iov_base = msgs[sent + i].buf;
+            iovs[i].iov_len = msgs[sent + i].size;
+            headers[i].msg_hdr.msg_iov = &iovs[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        const int result = sendmmsg(transport->fd, headers, chunk, MSG_NOSIGNAL);
+        if(result <= 0) return -1;
+        for(int i = 0; i < result; i++) {
+            if(headers[i].msg_len != msgs[sent + i].size) return -1;
+        }
+        sent += result;
+    }
+
+    return sent;
+}
+
+void transport_socket_close(transport_t *transport) {
+    if(transport->fd >= 0) close(transport->fd);
+    transport->fd = -1;
+}
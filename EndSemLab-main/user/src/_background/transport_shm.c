@@ -0,0 +1,76 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "include/shm_link.h"
+#include "include/transport.h"
+
+//=====================================
+//      OPERATIONS
+//=====================================
+
+static int shm_open_link(transport_t *transport, const char *address, const transport_role_t role, const uint8_t hello) {
+    shm_link_t *link = calloc(1, sizeof(shm_link_t));
+    if(!link) return -1;
+    shm_link_init(link);
+    transport->state = link;
+
+    // The rings are handed over on a unix socket, which is then kept open so the link notices its peer going away.
+    if(transport_unix_open(transport, address, role, hello) != 0) return -1;
+
+    int status;
+    if(role == TRANSPORT_ACCEPT) {
+        status = shm_link_create(link) == 0 && shm_link_share(link, transport->fd) == 0 ? 0 : -1;
+    }
+    else {
+        status = shm_link_attach(link, transport->fd);
+    }
+
+    if(status == 0) {
+        link->peer_sock = transport->fd;
+        transport->fd = -1;
+    }
+    transport_socket_close(transport);
+    return status;
+}
+
+static int shm_recv_batch(transport_t *transport, transport_msg_t *msgs, const int count) {
+    shm_link_t *link = transport->state;
+
+    const ssize_t size = shm_link_recv(link, msgs[0].buf, MAX_PACKET_SIZE);
+    if(size < 0) return -1;
+    msgs[0].size = (uint8_t) size;
+
+    int received = 1;
+    while(received < count) {
+        const ssize_t size = shm_link_try_recv(link, msgs[received].buf, MAX_PACKET_SIZE);
+        if(size <= 0) break;
+        msgs[received].size = (uint8_t) size;
+        received += 1;
+    }
+
+    return received;
+}
+
+static int shm_send_batch(transport_t *transport, const transport_msg_t *msgs, const int count) {
+    for(int i = 0; i < count; i++) {
+        if(shm_link_send(transport->state, msgs[i].buf, msgs[i].size) != 0) return i > 0 ? i : -1;
+    }
+    return count;
+}
+
+static void shm_close(transport_t *transport) {
+    if(transport->state) shm_link_close(transport->state);
+    free(transport->state);
+    transport->state = NULL;
+}
+
+//=====================================
+//      TRANSPORT
+//=====================================
+
+const transport_ops_t transport_shm = {
+    .name = "shm",
+    .open = shm_open_link,
+    .recv_batch = shm_recv_batch,
+    .send_batch = shm_send_batch,
+    .close = shm_close,
+};
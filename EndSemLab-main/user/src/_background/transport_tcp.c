@@ -0,0 +1,167 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "include/transport.h"
+
+//=====================================
+//      STRUCTURES
+//=====================================
+
+// Bytes read from the stream that have not been handed out as packets yet.
+typedef struct tcp_state {
+    size_t begin;
+    size_t end;
+    uint8_t buf[TRANSPORT_BATCH_MAX * MAX_PACKET_SIZE];
+} tcp_state_t;
+
+//=====================================
+//      HELPERS
+//=====================================
+
+static int tcp_address(struct sockaddr_in *addr, const char *address) {
+    char ip[INET_ADDRSTRLEN];
+    unsigned int port;
+    if(sscanf(address, "%15[^:]:%u", ip, &port) != 2 || port > UINT16_MAX) return -1;
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(port);
+    return inet_pton(AF_INET, ip, &addr->sin_addr) == 1 ? 0 : -1;
+}
+
+/**
+ * Connects without blocking for longer than `TRANSPORT_CONNECT_TIMEOUT_MS`, however long the peer takes to answer.
+ * Return Value - The connected (blocking) socket, or -1.
+ */
+static int tcp_connect(const struct sockaddr_in *addr) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if(sock < 0) return -1;
+
+    const int flags = fcntl(sock, F_GETFL);
+    int error = 0;
+    socklen_t error_size = sizeof(error);
+    struct pollfd poll_fd = { sock, POLLOUT, 0 };
+
+    if(flags < 0 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) != 0) goto fail;
+    if(connect(sock, (const struct sockaddr *) addr, sizeof(*addr)) != 0) {
+        if(errno != EINPROGRESS) goto fail;
+        if(poll(&poll_fd, 1, TRANSPORT_CONNECT_TIMEOUT_MS) != 1) goto fail;
+        if(getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &error_size) != 0 || error != 0) goto fail;
+    }
+    if(fcntl(sock, F_SETFL, flags) != 0) goto fail;
+    return sock;
+
+fail:
+    close(sock);
+    return -1;
+}
+
+static int tcp_accept(const struct sockaddr_in *addr) {
+    int listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+    if(listen_sock < 0) return -1;
+
+    int sock = -1;
+    if(setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &(int){1}, sizeof(int)) == 0 &&
+        setsockopt(listen_sock, SOL_SOCKET, SO_REUSEPORT, &(int){1}, sizeof(int)) == 0 &&
+        bind(listen_sock, (const struct sockaddr *) addr, sizeof(*addr)) == 0 &&
+        listen(listen_sock, 0) == 0) {
+        sock = accept(listen_sock, NULL, NULL);
+    }
+
+    close(listen_sock);
+    return sock;
+}
+
+/**
+ * Cuts the next packet off the buffered stream, using the length field of its header.
+ * A packet claiming to be shorter than a header is taken to span everything buffered.
+ * Return Value - 1 if a packet was cut, else 0.
+ */
+static int tcp_frame(tcp_state_t *state, transport_msg_t *msg) {
+    const size_t available = state->end - state->begin;
+    if(available < 3) return 0;
+
+    size_t length = state->buf[state->begin + 2];
+    if(length < HEADER_SIZE) length = available < MAX_PACKET_SIZE ? available : MAX_PACKET_SIZE;
+    if(length > available) return 0;
+
+    memcpy(msg->buf, state->buf + state->begin, length);
+    msg->size = (uint8_t) length;
+    state->begin += length;
+    return 1;
+}
+
+//=====================================
+//      OPERATIONS
+//=====================================
+
+static int tcp_open(transport_t *transport, const char *address, const transport_role_t role, const uint8_t hello) {
+    struct sockaddr_in addr;
+    if(tcp_address(&addr, address) != 0) return -1;
+
+    transport->fd = role == TRANSPORT_CONNECT ? tcp_connect(&addr) : tcp_accept(&addr);
+    if(transport->fd < 0) return -1;
+
+    // Packets are small and latency bound, don't let Nagle hold them back.
+    setsockopt(transport->fd, IPPROTO_TCP, TCP_NODELAY, &(int){1}, sizeof(int));
+
+    transport->state = calloc(1, sizeof(tcp_state_t));
+    if(!transport->state) return -1;
+
+    uint8_t byte = hello;
+    if(role == TRANSPORT_CONNECT) {
+        return send(transport->fd, &byte, sizeof(byte), 0) == sizeof(byte) ? 0 : -1;
+    }
+    else {
+        if(recv(transport->fd, &byte, sizeof(byte), 0) != sizeof(byte)) return -1;
+        return byte == hello ? 0 : -1;
+    }
+}
+
+static int tcp_recv_batch(transport_t *transport, transport_msg_t *msgs, const int count) {
+    tcp_state_t *state = transport->state;
+
+    int received = 0;
+    while(1) {
+        while(received < count && tcp_frame(state, &msgs[received])) {
+            received += 1;
+        }
+        if(received > 0) return received;
+
+        // Keep the partial packet at the front and read more behind it.
+        memmove(state->buf, state->buf + state->begin, state->end - state->begin);
+        state->end -= state->begin;
+        state->begin = 0;
+
+        const ssize_t bytes_read = recv(transport->fd, state->buf + state->end, sizeof(state->buf) - state->end, 0);
+        if(bytes_read <= 0) return (int) bytes_read;
+        state->end += bytes_read;
+    }
+}
+
+static void tcp_close(transport_t *transport) {
+    transport_socket_close(transport);
+    free(transport->state);
+    transport->state = NULL;
+}
+
+//=====================================
+//      TRANSPORT
+//=====================================
+
+const transport_ops_t transport_tcp = {
+    .name = "tcp",
+    .open = tcp_open,
+    .recv_batch = tcp_recv_batch,
+    .send_batch = transport_socket_send_batch,
+    .close = tcp_close,
+};
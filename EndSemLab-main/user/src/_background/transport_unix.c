@@ -0,0 +1,109 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "include/transport.h"
+
+//=====================================
+//      HELPERS
+//=====================================
+
+static int unix_address(struct sockaddr_un *addr, const char *path) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(addr->sun_path)) return -1;
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+static int unix_connect(const struct sockaddr_un *addr) {
+    int sock = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if(sock < 0) return -1;
+    if(connect(sock, (const struct sockaddr *) addr, sizeof(*addr)) != 0) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+static int unix_accept(const struct sockaddr_un *addr) {
+    int listen_sock = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if(listen_sock < 0) return -1;
+
+    // Remove any stale socket file from an earlier run.
+    unlink(addr->sun_path);
+
+    int sock = -1;
+    if(bind(listen_sock, (const struct sockaddr *) addr, sizeof(*addr)) == 0 && listen(listen_sock, 0) == 0) {
+        sock = accept(listen_sock, NULL, NULL);
+    }
+
+    close(listen_sock);
+    unlink(addr->sun_path);
+    return sock;
+}
+
+//=====================================
+//      OPERATIONS
+//=====================================
+
+/**
+ * Opens a unix domain `SOCK_SEQPACKET` socket at `address` and exchanges the hello byte.
+ * Every send on the socket is received as exactly one packet on the other end.
+ */
+int transport_unix_open(transport_t *transport, const char *address, const transport_role_t role, const uint8_t hello) {
+    struct sockaddr_un addr;
+    if(unix_address(&addr, address) != 0) return -1;
+
+    transport->fd = role == TRANSPORT_CONNECT ? unix_connect(&addr) : unix_accept(&addr);
+    if(transport->fd < 0) return -1;
+
+    uint8_t byte = hello;
+    if(role == TRANSPORT_CONNECT) {
+        return send(transport->fd, &byte, sizeof(byte), 0) == sizeof(byte) ? 0 : -1;
+    }
+    else {
+        if(recv(transport->fd, &byte, sizeof(byte), 0) != sizeof(byte)) return -1;
+        return byte == hello ? 0 : -1;
+    }
+}
+
+static int unix_recv_batch(transport_t *transport, transport_msg_t *msgs, const int count) {
+    struct mmsghdr headers[TRANSPORT_BATCH_MAX];
+    struct iovec iovs[TRANSPORT_BATCH_MAX];
+
+    const int chunk = count < TRANSPORT_BATCH_MAX ? count : TRANSPORT_BATCH_MAX;
+    memset(headers, 0, sizeof(headers[0]) * chunk);
+    for(int i = 0; i < chunk; i++) {
+        iovs[i].iov_base = msgs[i].buf;
+        iovs[i].iov_len = MAX_PACKET_SIZE;
+        headers[i].msg_hdr.msg_iov = &iovs[i];
+        headers[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // Block for the first packet only, then take whatever else is already queued.
+    const int result = recvmmsg(transport->fd, headers, chunk, MSG_WAITFORONE, NULL);
+    if(result < 0) return -1;
+
+    // A zero length message means the peer closed the link.
+    for(int i = 0; i < result; i++) {
+        if(headers[i].msg_len == 0) return i;
+        msgs[i].size = (uint8_t) headers[i].msg_len;
+    }
+
+    return result;
+}
+
+//=====================================
+//      TRANSPORT
+//=====================================
+
+const transport_ops_t transport_unix = {
+    .name = "unix",
+    .open = transport_unix_open,
+    .recv_batch = unix_recv_batch,
+    .send_batch = transport_socket_send_batch,
+    .close = transport_socket_close,
+};
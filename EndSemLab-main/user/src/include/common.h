@@ -25,6 +25,12 @@
 // Application must drop a packet if it would exceed the maximum packet size after performing its operation on it.
 #define PACKET_DROP_TOO_LARGE 104
 
+// Packet arriving faster than the rate limits configured for its link or source address. (Dropped by the router driver.)
+#define PACKET_DROP_RATE_LIMITED 105
+
+// Data packet already seen on another link moments ago, as it loops while routing tables converge.
+#define PACKET_DROP_DUPLICATE 106
+
 // Use this drop code for any other reason for dropping other than the ones mentioned above, if needed.
 #define PACKET_DROP_GENERAL 99
 
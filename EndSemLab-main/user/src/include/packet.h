@@ -16,6 +16,7 @@
 #define HEADER_SIZE 8
 #define MAX_PAYLOAD_SIZE (MAX_PACKET_SIZE - HEADER_SIZE)
 
+#define PACKET_TYPE_HELLO 2
 #define PACKET_TYPE_COMMAND 4
 #define PACKET_TYPE_DATA 8
 
@@ -23,6 +24,8 @@
 #define COMMAND_ENTRY_SIZE 2
 #define MAX_COMMAND_ENTRIES ((MAX_PACKET_SIZE - (HEADER_SIZE + COMMAND_HEADER_SIZE)) / COMMAND_ENTRY_SIZE)
 
+#define HELLO_SIZE 6
+
 //=====================================
 //      STRUCTURES
 //=====================================
@@ -42,7 +45,7 @@
 //                          Lower 4 bits (0-3) - TTL (4 bits)
 //                          Bit 6 - ACK flag
 //                          Bits 4, 5, 7 - unused (zero)
-//  4           1           Upper 4 bits (4-7) - Type (command packet = 4, data packet = 8)
+//  4           1           Upper 4 bits (4-7) - Type (hello packet = 2, command packet = 4, data packet = 8)
 //                          Lower 4 bits (0-3) - Highest 4 bits (out of 12) of Seq. No.
 //  5           1           Lowest 8 bits (out of 12) of Seq. No.
 //  6           1           8-bit 1's complement checksum of full packet (including header)
@@ -56,7 +59,9 @@
 //  Command Header:
 //  Offset      Size        Description
 //  0           1           No. of DV Table entries in this packet
-//  1           1           Upper 4 bits (4-7) - unused
+//  1           1           Bit 4 - Delta flag: the entries only change the vector last sent, rather than replace it
+//                          Bit 5 - MORE flag: the vector continues in the next command, which has the same timestamp
+//                          Bits 6-7 - unused (zero)
 //                          Lower 4 bits (0-3) - Highest 4 bits (out of 20) of timestamp (number of seconds since midnight)
 //  2           2           Lower 16 bits (out of 20) of timestamp
 //
@@ -64,6 +69,14 @@
 //  5           1           Destination Subnet
 //  6           1           Cost
 //  Entry format continues for the rest of the packet. [Entry 2 is at offsets (7, 8), entry 3 at (9, 10), etc.]
+//
+//  Hello packet payload format (sent to neighbours only, to show the link is alive):
+//  Offset      Size        Description
+//  0           1           Detection multiplier: the sender is considered down after this many intervals without a hello
+//  1           1           Bit 0 - REPLY flag (the hello answers one from the receiver, whose timestamp it echoes). Bits 1-7 unused
+//  2           2           Interval between the sender's hellos, in milliseconds
+//  4           2           Timestamp: the sender's clock in milliseconds (wrapping), or the echoed one in a reply.
+//                          0 if the sender does not measure round trips, and wants no reply
 
 
 typedef struct cmd_entry {
@@ -73,10 +86,19 @@ typedef struct cmd_entry {
 
 typedef struct cmd_payload {
     uint8_t entry_count;
+    uint8_t flag_delta;
+    uint8_t flag_more;
     uint32_t timestamp;
     cmd_entry_t entries[MAX_COMMAND_ENTRIES];
 } cmd_payload_t;
 
+typedef struct hello_payload {
+    uint8_t multiplier;
+    uint8_t flag_reply;
+    uint16_t interval_ms;
+    uint16_t timestamp_ms;
+} hello_payload_t;
+
 typedef struct packet {
     uint8_t src;
     uint8_t dest;
@@ -88,7 +110,7 @@ typedef struct packet {
 
     uint16_t seq_no;
 
-    // This is a union field (since each packet can either have a data payload or a cmd payload.
+    // This is a union field (since each packet can either have a data payload, a cmd payload or a hello payload.
     // If `pkt` is the name of a packet_t variable,
     // you can access the payload as a data payload with `pkt.payload_as.data`,
     // and as a cmd payload with `pkt.payload_as.cmd`.
@@ -97,6 +119,7 @@ typedef struct packet {
     union {
         uint8_t data[MAX_PAYLOAD_SIZE];
         cmd_payload_t cmd;
+        hello_payload_t hello;
     } payload_as;
 } packet_t;
 
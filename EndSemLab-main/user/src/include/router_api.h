@@ -7,14 +7,29 @@
 //      MACROS
 //=====================================
 
-#define ROUTER_ADDR 12
-#define APPLICATION_ADDR 14
-#define ROUTER_LINK_COUNT 4
+// The most links a router can have (See `router_get_link_count()`).
+#define ROUTER_MAX_LINK_COUNT 64
+
+// Most packets `send_buffers_to_link()` sends at once.
+#define ROUTE_BATCH_MAX 32
+
+// Link mask (for `send_buffer_to_links()`) selecting every link of a router with `link_count` links.
+#define ROUTER_LINKS_MASK(link_count) ((link_count) >= 64 ? UINT64_MAX : (UINT64_C(1) << (link_count)) - 1)
 
 // This will be the value of the `next_hop_link` field of the `dv_entry_t` struct
 // for the entry with the router's subnet as the destination subnet.
 #define NO_NEXT_HOP_LINK 0xFF
 
+// A cost of `DV_COST_INFINITY` in a distance vector means the destination is unreachable.
+#define DV_COST_INFINITY 0xFF
+
+// Values of `router_get_split_horizon()`.
+// With split horizon, routes are left out of the vector sent over the link they were learnt from.
+// With poison reverse, they are sent over it as unreachable instead.
+#define SPLIT_HORIZON_OFF 0
+#define SPLIT_HORIZON_ON 1
+#define SPLIT_HORIZON_POISON_REVERSE 2
+
 //=====================================
 //      STRUCTURES
 //=====================================
@@ -27,27 +42,86 @@ typedef struct dv_entry {
     uint8_t cost;
 
     // The link which connects this router to the next hop towards the destination.
-    // Possible values are from 0 to `ROUTER_LINK_COUNT - 1`, both inclusive,
+    // Possible values are from 0 to `router_get_link_count() - 1`, both inclusive,
     // or `NO_NEXT_HOP_LINK` as stated in the MACROS section above.
     uint8_t next_hop_link;
 } dv_entry_t;
 
+/**
+ * A handle to one router. A process may host many routers, each with its own table and links,
+ * so every function below takes the router it acts on.
+ */
+typedef struct router_instance router_instance_t;
+
+/**
+ * A timer run by the router driver (See `router_timer_start()`).
+ * Embed it in the state it acts on and set it up with `router_timer_init()`. Its fields are private to the driver.
+ */
+typedef struct router_timer {
+    struct router_timer *next;
+    struct router_timer *prev;
+    uint64_t expires;
+    void (*fn)(router_instance_t *router, struct router_timer *timer, void *arg);
+    void *arg;
+} router_timer_t;
+
+/**
+ * Called on the driver's timer thread when a timer expires, without any lock of the driver held.
+ * `timer` - The timer which expired. It is no longer pending, so it may be started again.
+ * `arg` - The argument given to `router_timer_init()`.
+ */
+typedef void (*router_timer_fn_t)(router_instance_t *router, router_timer_t *timer, void *arg);
+
+/**
+ * One packet of a batch handed to `route_batch()`.
+ */
+typedef struct route_msg {
+    // The serialised packet, which may be modified.
+    uint8_t *buf;
+    uint8_t size;
+    // The router link the packet was received on.
+    uint8_t link;
+} route_msg_t;
+
 //=====================================
 //      FUNCTIONS
 //=====================================
 
 /**
  * NOTE: THESE FUNCTIONS SHOULD ONLY BE CALLED IN THE ROUTER.
+ * `router` - The router passed to `route()`.
  */
 
 /**
  * Sends a packet over a router link to another subnet (For sending to the application, use `send_buffer_to_app()`).
- * `link` - The link to send the packet over. Possible values are from 0 to `ROUTER_LINK_COUNT - 1`, both inclusive.
+ * `link` - The link to send the packet over. Possible values are from 0 to `router_get_link_count() - 1`, both inclusive.
  * `buf` - The serialised packet to send.
  * `size` - The size of the buffer.
- * Return Value - 0 if the packet was sent properly, else -1.
+ * Return Value - 0 if the packet was sent properly, else -1 (also while the link is lost, see `route_link_changed()`).
+ */
+int send_buffer_to_link(router_instance_t *router, const uint8_t link, const uint8_t *buf, const uint8_t size);
+
+/**
+ * Sends the same packet over several router links (For sending to the application, use `send_buffer_to_app()`).
+ * The packet only has to be serialised once; each copy differs at most in its destination address and checksum.
+ * `link_mask` - The links to send the packet over. Bit `i` set means the packet is sent over link `i`.
+ * `buf` - The serialised packet to send. Its destination and checksum bytes are overwritten if `patch_dest` is set.
+ * `size` - The size of the buffer.
+ * `patch_dest` - If non-zero, the destination of each copy is set to the address of the neighbour subnet at the other end of its link.
+ * Return Value - 0 if the packet was sent properly over every link in the mask, else -1.
+ *                The packet is still sent over the other links when some fail or are lost.
+ */
+int send_buffer_to_links(router_instance_t *router, const uint64_t link_mask, uint8_t *buf, const uint8_t size, const uint8_t patch_dest);
+
+/**
+ * Sends several packets over a router link, in order, with a single call into the link's transport.
+ * `link` - The link to send the packets over. Possible values are from 0 to `router_get_link_count() - 1`, both inclusive.
+ * `bufs` - The serialised packets to send.
+ * `sizes` - The size of each buffer.
+ * `count` - The number of packets, at most `ROUTE_BATCH_MAX`.
+ * Return Value - The number of packets sent, which are the first ones, or -1 if none could be (also while the link is lost).
  */
-int send_buffer_to_link(const uint8_t link, const uint8_t *buf, const uint8_t size);
+int send_buffers_to_link(router_instance_t *router, const uint8_t link, uint8_t *const *bufs, const uint8_t *sizes, const int count);
 
 /**
  * Sends a packet to the application.
@@ -55,37 +129,260 @@ int send_buffer_to_link(const uint8_t link, const uint8_t *buf, const uint8_t si
  * `size` - The size of the buffer.
  * Return Value - 0 if the packet was sent properly, else -1.
  */
-int send_buffer_to_app(const uint8_t *buf, const uint8_t size);
+int send_buffer_to_app(router_instance_t *router, const uint8_t *buf, const uint8_t size);
+
+/**
+ * Gets the number of links of the router to other subnets, as set in its config.
+ * Packets from the application are passed to `route()` with this value as their link.
+ * Return Value - The number of links (at most `ROUTER_MAX_LINK_COUNT`).
+ */
+int router_get_link_count(const router_instance_t *router);
+
+/**
+ * Return Value - The address of the router. Its upper 6 bits are the router's own subnet.
+ */
+uint8_t router_get_address(const router_instance_t *router);
+
+/**
+ * Return Value - The address of the application behind the router.
+ */
+uint8_t router_get_app_address(const router_instance_t *router);
 
 /**
  * Gets the weight (cost) of a link of the router.
- * `link` - The link. Possible values are from 0 to `ROUTER_LINK_COUNT - 1`, both inclusive.
+ * `link` - The link. Possible values are from 0 to `router_get_link_count() - 1`, both inclusive.
  * Return Value - The weight of the link (fits in 8 bits) if link was valid, else -1.
  */
-int router_get_link_weight(const uint8_t link);
+int router_get_link_weight(const router_instance_t *router, const uint8_t link);
+
+/**
+ * Changes the weight of a link while the router runs. Only to be called by `route()` and its routines:
+ * with the weight `route_link_weight_changed()` is handed when the config is reloaded,
+ * or with one derived from measurements of the link (See `router_get_latency_cost_ms()`).
+ * `link` - The link. Possible values are from 0 to `router_get_link_count() - 1`, both inclusive.
+ * Return Value - 0 if link was valid, else -1.
+ */
+int router_set_link_weight(router_instance_t *router, const uint8_t link, const uint8_t weight);
 
 /**
  * Gets the subnet value (6 bits) of the subnet connected to by a link.
- * `link` - The link. Possible values are from 0 to `ROUTER_LINK_COUNT - 1`, both inclusive.
+ * `link` - The link. Possible values are from 0 to `router_get_link_count() - 1`, both inclusive.
  * Return Value - The 6-bit subnet at the other end of the link if link was valid, else -1.
  */
-int router_get_neighbour_subnet(const uint8_t link);
+int router_get_neighbour_subnet(const router_instance_t *router, const uint8_t link);
+
+/**
+ * Gets how routes are advertised back over the link they were learnt from, as set in the router's config.
+ * Return Value - One of the `SPLIT_HORIZON_*` values (`SPLIT_HORIZON_OFF` by default).
+ */
+int router_get_split_horizon(const router_instance_t *router);
+
+/**
+ * Gets whether table changes should be advertised as delta commands, holding only the entries that changed,
+ * as set in the router's config. The first advertisement of a router is always the whole table.
+ * Return Value - 1 for delta commands, 0 for the whole table every time (the default).
+ */
+int router_get_delta_updates(const router_instance_t *router);
+
+/**
+ * Gets how long table changes should be held and merged before they are advertised, as set in the router's config.
+ * Return Value - The window in milliseconds, 0 to advertise every change at once (the default).
+ */
+int router_get_coalesce_window_ms(const router_instance_t *router);
+
+/**
+ * Gets the width of destination subnets in the routing table, 6 bits unless the router's config sets `address_bits`.
+ * NOTE: Packets only carry 6-bit subnets, wider subnets can only be reached through the prefix functions below.
+ * Return Value - The width in bits (at most 24).
+ */
+int router_get_address_bits(const router_instance_t *router);
 
 /**
- * Gets the entry from the router distance vector table.
- * `dest_subnet` - The destination subnet (6 bits) which the entry is for.
+ * Gets the entry to forward a packet with: the entry of the longest prefix in the table containing the destination.
+ * `dest` - The destination subnet (`router_get_address_bits()` bits).
+ * Return Value - A pointer to the entry in the table if a prefix contains the destination, otherwise NULL.
+ * NOTE: Do not modify the entry using this pointer. Use `dv_set_entry()` instead.
+ */
+const dv_entry_t *dv_lookup(const router_instance_t *router, const uint32_t dest);
+
+/**
+ * Gets the entry of exactly the whole destination subnet from the router distance vector table.
+ * `dest_subnet` - The destination subnet (`router_get_address_bits()` bits) which the entry is for.
  * Return Value - A pointer to the entry in the table if it exists, otherwise NULL.
  * NOTE: Do not modify the entry using this pointer. Use `dv_set_entry()` instead.
  */
-const dv_entry_t *dv_get_entry(const uint8_t dest_subnet);
+const dv_entry_t *dv_get_entry(const router_instance_t *router, const uint32_t dest_subnet);
 
 /**
- * Sets an entry in the router distance vector table.
- * `dest_subnet` - The destination subnet (6 bits) which the entry is for.
+ * Sets the entry of a whole destination subnet in the router distance vector table.
+ * `dest_subnet` - The destination subnet (`router_get_address_bits()` bits) which the entry is for.
  * `cost` - The cost to the destination.
- * `next_hop_link` - The link which connects this router to the next hop towards the destination. Possible values are from 0 to `ROUTER_LINK_COUNT - 1`, both inclusive.
+ * `next_hop_link` - The link which connects this router to the next hop towards the destination. Possible values are from 0 to `router_get_link_count() - 1`, both inclusive.
  * Return Value - 0 if the entry was set properly, else -1.
  */
-int dv_set_entry(const uint8_t dest_subnet, const uint8_t cost, const uint8_t next_hop_link);
+int dv_set_entry(router_instance_t *router, const uint32_t dest_subnet, const uint8_t cost, const uint8_t next_hop_link);
+
+/**
+ * Gets the entry of exactly the prefix `prefix/prefix_len` (See `dv_get_entry()`).
+ * `prefix` - A destination subnet whose upper `prefix_len` bits (out of `router_get_address_bits()`) form the prefix.
+ * `prefix_len` - From 0 to `router_get_address_bits()`, both inclusive.
+ */
+const dv_entry_t *dv_get_prefix_entry(const router_instance_t *router, const uint32_t prefix, const uint8_t prefix_len);
+
+/**
+ * Sets the entry of the prefix `prefix/prefix_len` (See `dv_set_entry()` and `dv_get_prefix_entry()`).
+ * Destinations within the prefix use this entry unless a longer prefix also contains them.
+ */
+int dv_set_prefix_entry(router_instance_t *router, const uint32_t prefix, const uint8_t prefix_len, const uint8_t cost, const uint8_t next_hop_link);
+
+/**
+ * Removes the entry of a whole destination subnet from the router distance vector table.
+ * Destinations in the subnet fall back to the longest shorter prefix containing them, if any.
+ * Pointers to the removed entry must not be used afterwards.
+ * `dest_subnet` - The destination subnet (`router_get_address_bits()` bits) which the entry is for.
+ * Return Value - 0 if the entry was removed, -1 if there was no such entry.
+ */
+int dv_delete_entry(router_instance_t *router, const uint32_t dest_subnet);
+
+/**
+ * Removes the entry of the prefix `prefix/prefix_len` (See `dv_delete_entry()` and `dv_get_prefix_entry()`).
+ */
+int dv_delete_prefix_entry(router_instance_t *router, const uint32_t prefix, const uint8_t prefix_len);
+
+/**
+ * Walks the valid entries of the table (whole subnets and shorter prefixes), in no particular order.
+ * The walk costs in proportion to the number of valid entries, however wide the addresses.
+ * `cursor` - Where the walk is, 0 to start it. Advanced past the entry returned.
+ * `prefix`, `prefix_len` - Set to the prefix of the entry returned (See `dv_get_prefix_entry()`), unless NULL.
+ * Return Value - The next valid entry, or NULL once the walk is over.
+ * NOTE: Do not modify the entry using this pointer. Use `dv_set_entry()` instead.
+ */
+const dv_entry_t *dv_next_entry(const router_instance_t *router, uint32_t *cursor, uint32_t *prefix, uint8_t *prefix_len);
+
+/**
+ * Sets up a timer which is not pending.
+ * `fn` - Called when the timer expires.
+ * `arg` - Passed to `fn`.
+ */
+void router_timer_init(router_timer_t *timer, router_timer_fn_t fn, void *arg);
+
+/**
+ * Starts a timer, or restarts it if it is already pending. Takes constant time however many timers are pending.
+ * `delay_ms` - Milliseconds until the timer expires.
+ */
+void router_timer_start(router_instance_t *router, router_timer_t *timer, const uint32_t delay_ms);
+
+/**
+ * Stops a timer if it is pending. A timer which has just expired may still have its function called once.
+ */
+void router_timer_stop(router_instance_t *router, router_timer_t *timer);
+
+/**
+ * Return Value - 1 if the timer is started and has not expired yet, else 0.
+ */
+int router_timer_is_pending(router_instance_t *router, const router_timer_t *timer);
+
+/**
+ * Gets the interval at which the whole table should be advertised even if it has not changed, as set in the router's config.
+ * Return Value - The interval in milliseconds, 0 for no periodic advertisement (the default).
+ */
+int router_get_refresh_interval_ms(const router_instance_t *router);
+
+/**
+ * Gets how long a route learnt from a neighbour lasts without being advertised again, as set in the router's config.
+ * Return Value - The time in milliseconds, 0 for routes which never expire (the default).
+ */
+int router_get_route_timeout_ms(const router_instance_t *router);
+
+/**
+ * Gets how long no new route to a destination should be taken after the last route to it was lost, as set in the router's config.
+ * Return Value - The time in milliseconds, 0 for no hold-down (the default).
+ */
+int router_get_holddown_ms(const router_instance_t *router);
+
+/**
+ * Return Value - 1 if the router's table was reloaded from its state file rather than filled from the config alone, else 0.
+ *                Reloaded entries should be treated as stale until neighbours confirm them.
+ */
+int router_is_warm_started(const router_instance_t *router);
+
+/**
+ * Gets how long reloaded entries should be kept without being confirmed by a neighbour, as set in the router's config.
+ * Return Value - The time in milliseconds, 0 to keep them until they are replaced.
+ */
+int router_get_stale_ms(const router_instance_t *router);
+
+/**
+ * Gets the timestamp of the last command accepted on a link, as saved with `router_set_link_timestamp()` by this run or the last.
+ * Return Value - The timestamp, or 0 if none was saved (or the router has no state file).
+ */
+uint32_t router_get_link_timestamp(const router_instance_t *router, const uint8_t link);
+
+/**
+ * Saves the timestamp of the last command accepted on a link in the router's state file, if it has one.
+ */
+void router_set_link_timestamp(router_instance_t *router, const uint8_t link, const uint32_t timestamp);
+
+/**
+ * Gets the interval at which hellos should be sent over every link, as set in the router's config.
+ * Return Value - The interval in milliseconds, 0 for no hellos (the default). Links are then always considered up.
+ */
+int router_get_hello_interval_ms(const router_instance_t *router);
+
+/**
+ * Gets how many hello intervals a neighbour may miss before its link is considered down, as set in the router's config.
+ * Return Value - The multiplier (3 by default).
+ */
+int router_get_hello_multiplier(const router_instance_t *router);
+
+/**
+ * Gets how long a data packet should be remembered, as set in the router's config.
+ * The same packet arriving again on another link within that time is looping (as tables converge), and should be dropped
+ * with `PACKET_DROP_DUPLICATE`.
+ * Return Value - The window in milliseconds, 0 to never drop packets as duplicates (the default).
+ */
+int router_get_duplicate_window_ms(const router_instance_t *router);
+
+/**
+ * Gets the smoothed round trip time on a link worth 1 of link weight, as set in the router's config.
+ * Round trips are measured by hellos, whose replies echo their timestamp (See `hello_payload_t`).
+ * Return Value - The time in milliseconds, 0 if latency should not change link weights (the default).
+ */
+int router_get_latency_cost_ms(const router_instance_t *router);
+
+/**
+ * Gets the smoothed send queue depth on a link worth 1 of link weight, as set in the router's config.
+ * Return Value - The depth in bytes, 0 if queue depth should not change link weights (the default).
+ */
+uint32_t router_get_queue_cost_bytes(const router_instance_t *router);
+
+/**
+ * Gets the number of bytes sent over a link which its transport has not handed to the network yet.
+ * `link` - The link. Possible values are from 0 to `router_get_link_count() - 1`, both inclusive.
+ * Return Value - The number of bytes (0 while the link is lost, or if its transport cannot tell), or -1 if link was invalid.
+ */
+int router_get_link_queue_bytes(router_instance_t *router, const uint8_t link);
+
+/**
+ * Gets the members of a multicast group, as set in the router's config.
+ * A data packet to a group is sent once over each member link (but the one it arrived on),
+ * and to the application if it is a member.
+ * `address` - A packet destination address.
+ * `link_mask` - Set to the member links, bit `i` set for link `i` (as for `send_buffer_to_links()`). May be NULL.
+ * `is_app_member` - Set to 1 if the application is a member, else 0. May be NULL.
+ * Return Value - 1 if `address` is a multicast group of the router, else 0 (and nothing is set).
+ */
+int router_get_multicast_group(const router_instance_t *router, const uint8_t address, uint64_t *link_mask, int *is_app_member);
+
+/**
+ * Attaches the state `route()` keeps between packets (such as the last command timestamp) to a router.
+ * `state` - Memory allocated with `malloc()`. It is freed with `free()` when the router is destroyed.
+ */
+void router_set_route_state(router_instance_t *router, void *state);
+
+/**
+ * Return Value - The state attached with `router_set_route_state()`, or NULL if there is none.
+ */
+void *router_get_route_state(const router_instance_t *router);
 
 #endif
\ No newline at end of file
@@ -42,6 +42,8 @@ int packet_deserialise(packet_t *pkt, const uint8_t *buf, const ssize_t size) {
         buf += HEADER_SIZE;
 
         payload->entry_count = buf[0];
+        payload->flag_delta = (buf[1] & (1 << 4)) != 0;
+        payload->flag_more = (buf[1] & (1 << 5)) != 0;
         payload->timestamp = ((uint32_t) (buf[1] & 0x0F) << 16) | ((uint32_t) buf[2] << 8) | ((uint32_t) buf[3]);
         buf += COMMAND_HEADER_SIZE;
 
@@ -51,6 +53,17 @@ int packet_deserialise(packet_t *pkt, const uint8_t *buf, const ssize_t size) {
             entry->cost = buf[1];
         }
     }
+    else if(pkt->type == PACKET_TYPE_HELLO) {
+        if(pkt->length < HEADER_SIZE + HELLO_SIZE) { return -1; }
+
+        hello_payload_t *payload = &pkt->payload_as.hello;
+        buf += HEADER_SIZE;
+
+        payload->multiplier = buf[0];
+        payload->flag_reply = buf[1] & 1;
+        payload->interval_ms = ((uint16_t) buf[2] << 8) | (uint16_t) buf[3];
+        payload->timestamp_ms = ((uint16_t) buf[4] << 8) | (uint16_t) buf[5];
+    }
     else {
         return -1;
     }
@@ -81,7 +94,7 @@ int packet_serialise(const packet_t *pkt, uint8_t *buf, const ssize_t size) {
         buf += HEADER_SIZE;
 
         buf[0] = payload->entry_count;
-        buf[1] = (payload->timestamp & 0x000F0000) >> 16;
+        buf[1] = (payload->flag_more << 5) | (payload->flag_delta << 4) | ((payload->timestamp & 0x000F0000) >> 16);
         buf[2] = (payload->timestamp & 0x0000FF00) >> 8;
         buf[3] = payload->timestamp & 0x000000FF;
 
@@ -92,6 +105,19 @@ int packet_serialise(const packet_t *pkt, uint8_t *buf, const ssize_t size) {
             buf[1] = entry->cost;
         }
     }
+    else if(pkt->type == PACKET_TYPE_HELLO) {
+        if(pkt->length < HEADER_SIZE + HELLO_SIZE) return -1;
+
+        const hello_payload_t *payload = &pkt->payload_as.hello;
+        buf += HEADER_SIZE;
+
+        buf[0] = payload->multiplier;
+        buf[1] = payload->flag_reply ? 1 : 0;
+        buf[2] = (payload->interval_ms & 0xFF00) >> 8;
+        buf[3] = payload->interval_ms & 0x00FF;
+        buf[4] = (payload->timestamp_ms & 0xFF00) >> 8;
+        buf[5] = payload->timestamp_ms & 0x00FF;
+    }
     else {
         return -1;
     }
@@ -125,13 +151,24 @@ void packet_print(const packet_t *pkt) {
         const cmd_payload_t *payload = &pkt->payload_as.cmd;
         print("command:\n \
         entry_count: %u\n \
+        flag_delta: %u\n \
+        flag_more: %u\n \
         timestamp: %u\n \
         entries:\n",
-        payload->entry_count, payload->timestamp);
+        payload->entry_count, payload->flag_delta, payload->flag_more, payload->timestamp);
         for(int i = 0; i < payload->entry_count; i++) {
             print("\
             dest_subnet: %u, cost: %u\n", payload->entries[i].dest_subnet, payload->entries[i].cost);
         }
         print("\n");
     }
-}
\ No newline at end of file
+    else if(pkt->type == PACKET_TYPE_HELLO) {
+        const hello_payload_t *payload = &pkt->payload_as.hello;
+        print("hello:\n \
+        multiplier: %u\n \
+        flag_reply: %u\n \
+        interval_ms: %u\n \
+        timestamp_ms: %u\n\n",
+        payload->multiplier, payload->flag_reply, payload->interval_ms, payload->timestamp_ms);
+    }
+}
@@ -1,33 +1,1048 @@
 #include "include/common.h"
 #include "include/packet.h"
 #include "include/router_api.h"
+#include <pthread.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
-uint32_t last_timestamp = 0;
+// Command entries carry 8-bit subnets, of which the lowest `router_get_address_bits()` are used.
+#define VECTOR_SIZE 256
+#define VECTOR_WORDS (VECTOR_SIZE / 64)
+
+// Commands the router sends of its own accord (not in answer to a command) start with the highest TTL.
+#define COMMAND_TTL 15
+
+// Reasons for a link to be down (See `link_state_t.is_down`).
+#define LINK_DOWN_HELLO 1
+#define LINK_DOWN_TRANSPORT 2
+
+// What `dv_relax()` does with a destination whose advertised cost changed.
+#define RELAX_NONE 0
+#define RELAX_TAKE 1
+#define RELAX_RECOMPUTE 2
+
+// Link measurements are smoothed like TCP's round trip time: each sample moves the average 1/8 of the way.
+#define EWMA_SHIFT 3
+
+// A link weight derived from measurements only changes once it moves by this much, or back to the configured weight,
+// so routes do not flap with every sample.
+#define LINK_COST_HYSTERESIS 2
+
+// Data packets remembered at once (See `dv_is_duplicate()`). A power of two.
+#define DUPLICATE_CACHE_SIZE 256
+
+// Command timestamps are 20 bits wide.
+#define TIMESTAMP_MASK ((UINT32_C(1) << 20) - 1)
+#define TIMESTAMP_HALF ((TIMESTAMP_MASK + 1) / 2)
+
+/**
+ * State kept per router for each of its links.
+ */
+typedef struct link_state {
+    // The last distance vector received on the link.
+    // `advertised[subnet]` is the cost advertised for `subnet`, or `DV_COST_INFINITY`.
+    uint8_t advertised[VECTOR_SIZE];
+
+    // Timestamp of the last command accepted on the link. Neighbours timestamp their commands independently.
+    // Starts at 0, so the first command is accepted with any timestamp of the day (See `timestamp_is_newer()`).
+    uint32_t last_timestamp;
+
+    // A vector split across several commands, collected until its last command (without the MORE flag) arrives.
+    // `assembly[subnet]` is only meaningful for the subnets set in `assembly_listed`.
+    uint8_t assembly[VECTOR_SIZE];
+    uint64_t assembly_listed[VECTOR_WORDS];
+
+    // Subnets whose cost on this link was reloaded from the state file (See `router_is_warm_started()`),
+    // and has not been confirmed by the neighbour since.
+    uint64_t stale[VECTOR_WORDS];
+    uint32_t assembly_timestamp;
+    uint8_t is_assembling;
+    uint8_t is_assembly_delta;
+
+    // Expire the routes learnt on the link which are not advertised again (See `router_get_route_timeout_ms()`).
+    router_timer_t route_timers[VECTOR_SIZE];
+
+    // Restarted by every hello from the neighbour. On expiry the link is down, and nothing is routed over it until the next hello.
+    router_timer_t liveness_timer;
+    // The `LINK_DOWN_*` reasons the link is down for, 0 while it is up.
+    uint8_t is_down;
+
+    // The weight from the config (or `route_link_weight_changed()`), to which measurements add (See `dv_update_link_costs()`).
+    uint8_t base_weight;
+    // Smoothed round trip time in microseconds, from hello replies, and smoothed send queue depth in bytes.
+    uint32_t srtt_us;
+    uint32_t queue_bytes;
+} link_state_t;
+
+/**
+ * A data packet forwarded recently (See `dv_is_duplicate()`).
+ */
+typedef struct duplicate_slot {
+    // Hash of the packet, leaving out its TTL and checksum which change at every hop.
+    uint32_t hash;
+    uint8_t link;
+    // When the packet was last seen, 0 while the slot is empty.
+    uint64_t seen_ms;
+} duplicate_slot_t;
+
+/**
+ * State kept per router between calls to `route()`.
+ */
+typedef struct route_state {
+    uint32_t last_sent_timestamp;
+
+    // Subnets a vector can hold: `VECTOR_SIZE`, or fewer if subnets are narrower than 8 bits.
+    uint32_t subnet_count;
+
+    // Delta commands only make sense once neighbours have been sent the whole table.
+    uint8_t is_table_advertised;
+
+    // Links and timers call in from their own threads. Commands hold the lock for writing, data packets for reading.
+    pthread_rwlock_t table_lock;
+
+    // Table changes waiting for the end of the coalescing window (See `router_get_coalesce_window_ms()`).
+    router_timer_t coalesce_timer;
+    uint32_t pending_count;
+    uint64_t pending_changed[VECTOR_WORDS];
+    // The last command which changed the table, reused for the advertisement.
+    packet_t pending_pkt;
+
+    uint64_t changes_merged;
+    uint64_t updates_sent;
+
+    // Advertises the whole table periodically (See `router_get_refresh_interval_ms()`).
+    router_timer_t refresh_timer;
+
+    // Withdraws the reloaded routes still stale (See `router_get_stale_ms()`).
+    router_timer_t stale_timer;
+
+    // Sends hellos over every link (See `router_get_hello_interval_ms()`).
+    router_timer_t hello_timer;
+
+    // While pending, no new route to the subnet is taken (See `router_get_holddown_ms()`).
+    router_timer_t holddown_timers[VECTOR_SIZE];
+
+    // Data packets are routed in parallel under the table lock held for reading, so the cache has a lock of its own.
+    pthread_mutex_t duplicate_lock;
+    duplicate_slot_t duplicates[DUPLICATE_CACHE_SIZE];
+
+    link_state_t links[];
+} route_state_t;
+
+static inline int bitmap_test(const uint64_t *bitmap, const uint32_t bit) {
+    return (bitmap[bit / 64] >> (bit % 64)) & 1;
+}
+
+static inline void bitmap_set(uint64_t *bitmap, const uint32_t bit) {
+    bitmap[bit / 64] |= UINT64_C(1) << (bit % 64);
+}
+
+static inline void bitmap_clear(uint64_t *bitmap, const uint32_t bit) {
+    bitmap[bit / 64] &= ~(UINT64_C(1) << (bit % 64));
+}
+
+static inline uint32_t ewma(const uint32_t average, const uint32_t sample) {
+    return (uint32_t) ((int64_t) average + (((int64_t) sample - average) >> EWMA_SHIFT));
+}
+
+/**
+ * Timestamps compare as serial numbers: `a` is newer than `b` if it is less than half the timestamp space ahead of it.
+ * So a neighbour's timestamps keep increasing across the wrap from `TIMESTAMP_MASK` to 0, on both sides of the link.
+ */
+static inline int timestamp_is_newer(const uint32_t a, const uint32_t b) {
+    const uint32_t ahead = (a - b) & TIMESTAMP_MASK;
+    return ahead != 0 && ahead < TIMESTAMP_HALF;
+}
+
+static uint64_t monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * Gathers the entries of whole subnets which fit in a vector, walking only the valid entries of the table.
+ * `entries` - `VECTOR_SIZE` entries, set to the entry of every subnet which has one, and to an unreachable one otherwise.
+ * `present` - Bitmap of `VECTOR_SIZE` bits, set for the subnets which have an entry.
+ */
+static void dv_gather(router_instance_t *router, const route_state_t *state, dv_entry_t *entries, uint64_t *present) {
+    const int address_bits = router_get_address_bits(router);
+    memset(present, 0, sizeof(uint64_t) * VECTOR_WORDS);
+    // `DV_COST_INFINITY` and `NO_NEXT_HOP_LINK` are both all ones.
+    memset(entries, 0xFF, sizeof(dv_entry_t) * VECTOR_SIZE);
+
+    uint32_t cursor = 0;
+    uint32_t prefix;
+    uint8_t prefix_len;
+    const dv_entry_t *entry;
+    while((entry = dv_next_entry(router, &cursor, &prefix, &prefix_len))) {
+        if(prefix_len != address_bits || prefix >= state->subnet_count) continue;
+
+        entries[prefix] = *entry;
+        bitmap_set(present, prefix);
+    }
+}
+
+static void dv_coalesce_ended(router_instance_t *router, router_timer_t *timer, void *arg);
+static void dv_refresh(router_instance_t *router, router_timer_t *timer, void *arg);
+static void dv_route_expired(router_instance_t *router, router_timer_t *timer, void *arg);
+static void dv_holddown_ended(router_instance_t *router, router_timer_t *timer, void *arg);
+static void dv_hello(router_instance_t *router, router_timer_t *timer, void *arg);
+static void dv_link_down(router_instance_t *router, router_timer_t *timer, void *arg);
+static void dv_stale_expired(router_instance_t *router, router_timer_t *timer, void *arg);
+
+/**
+ * Rebuilds the vectors neighbours last advertised from a table reloaded from the state file:
+ * an entry through a link means the neighbour advertised its cost less the link weight.
+ * These costs stay stale until the neighbour advertises them again.
+ * Return Value - 1 if any cost was reloaded, else 0.
+ */
+static int dv_reload_vectors(router_instance_t *router, route_state_t *state) {
+    dv_entry_t entries[VECTOR_SIZE];
+    uint64_t present[VECTOR_WORDS];
+    dv_gather(router, state, entries, present);
+
+    int is_any_stale = 0;
+    for(uint32_t dest_subnet = 0; dest_subnet < state->subnet_count; dest_subnet++) {
+        const dv_entry_t *entry = &entries[dest_subnet];
+        if(!bitmap_test(present, dest_subnet) || entry->next_hop_link >= router_get_link_count(router)) continue;
+
+        const int weight = router_get_link_weight(router, entry->next_hop_link);
+        if(entry->cost < weight) continue;
+
+        link_state_t *link_state = &state->links[entry->next_hop_link];
+        link_state->advertised[dest_subnet] = entry->cost - weight;
+        bitmap_set(link_state->stale, dest_subnet);
+        is_any_stale = 1;
+    }
+    return is_any_stale;
+}
+
+/**
+ * This routine is called once for every router before it receives any packet.
+ * `router` - The router being set up.
+ * Return Value - 0 on success, -1 if the router's state could not be allocated (the router cannot run then).
+ */
+int route_init(router_instance_t *router) {
+    const int link_count = router_get_link_count(router);
+    route_state_t *state = calloc(1, sizeof(route_state_t) + sizeof(link_state_t) * link_count);
+    if(!state) return -1;
+
+    const int address_bits = router_get_address_bits(router);
+    state->subnet_count = address_bits < 8 ? UINT32_C(1) << address_bits : VECTOR_SIZE;
+    for(int link = 0; link < link_count; link++) {
+        link_state_t *link_state = &state->links[link];
+        memset(link_state->advertised, DV_COST_INFINITY, VECTOR_SIZE);
+        for(int subnet = 0; subnet < VECTOR_SIZE; subnet++) {
+            router_timer_init(&link_state->route_timers[subnet], dv_route_expired, link_state);
+        }
+        router_timer_init(&link_state->liveness_timer, dv_link_down, link_state);
+
+        // Commands replayed from before a restart are still outdated.
+        link_state->last_timestamp = router_get_link_timestamp(router, link);
+        link_state->base_weight = router_get_link_weight(router, link);
+    }
+
+    router_timer_init(&state->coalesce_timer, dv_coalesce_ended, state);
+    router_timer_init(&state->refresh_timer, dv_refresh, state);
+    router_timer_init(&state->hello_timer, dv_hello, state);
+    router_timer_init(&state->stale_timer, dv_stale_expired, state);
+    for(int subnet = 0; subnet < VECTOR_SIZE; subnet++) {
+        router_timer_init(&state->holddown_timers[subnet], dv_holddown_ended, state);
+    }
+
+    pthread_rwlock_init(&state->table_lock, NULL);
+    pthread_mutex_init(&state->duplicate_lock, NULL);
+    router_set_route_state(router, state);
+
+    if(router_get_refresh_interval_ms(router) > 0) {
+        router_timer_start(router, &state->refresh_timer, router_get_refresh_interval_ms(router));
+    }
+
+    // Reloaded routes keep forwarding traffic while neighbours confirm them.
+    if(router_is_warm_started(router) && dv_reload_vectors(router, state) && router_get_stale_ms(router) > 0) {
+        router_timer_start(router, &state->stale_timer, router_get_stale_ms(router));
+    }
+
+    // Neighbours get until their first hellos are due to show they are alive.
+    const uint32_t hello_ms = router_get_hello_interval_ms(router);
+    if(hello_ms > 0) {
+        router_timer_start(router, &state->hello_timer, hello_ms);
+        for(int link = 0; link < link_count; link++) {
+            router_timer_start(router, &state->links[link].liveness_timer, hello_ms * router_get_hello_multiplier(router));
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * This routine is called once for every router after it has received its last packet.
+ * `router` - The router being destroyed. Its state is freed afterwards.
+ */
+void route_destroy(router_instance_t *router) {
+    route_state_t *state = router_get_route_state(router);
+    if(!state) return;
+
+    router_timer_stop(router, &state->coalesce_timer);
+    router_timer_stop(router, &state->refresh_timer);
+    router_timer_stop(router, &state->hello_timer);
+    router_timer_stop(router, &state->stale_timer);
+    for(int link = 0; link < router_get_link_count(router); link++) {
+        router_timer_stop(router, &state->links[link].liveness_timer);
+    }
+    for(int subnet = 0; subnet < VECTOR_SIZE; subnet++) {
+        router_timer_stop(router, &state->holddown_timers[subnet]);
+        for(int link = 0; link < router_get_link_count(router); link++) {
+            router_timer_stop(router, &state->links[link].route_timers[subnet]);
+        }
+    }
+
+    if(router_get_coalesce_window_ms(router) > 0) {
+        print("[*] Router %u: %lu table changes merged, %lu updates advertised\n",
+            router_get_address(router), (unsigned long) state->changes_merged, (unsigned long) state->updates_sent);
+    }
+
+    pthread_rwlock_destroy(&state->table_lock);
+    pthread_mutex_destroy(&state->duplicate_lock);
+}
+
+/**
+ * Recomputes the entry of a destination subnet as the cheapest way to it: over the link to it if it is a neighbour,
+ * or through the neighbour at the other end of any link which is up, at the cost last advertised on that link plus the link weight.
+ * The entry is removed if no link reaches the destination, and the destination is held down if the router has a hold-down time.
+ * `dest_subnet` - The destination subnet to recompute.
+ * Return Value - 1 if the entry changed, else 0.
+ */
+static int dv_recompute(router_instance_t *router, route_state_t *state, const uint32_t dest_subnet) {
+    // The router's own subnet is always reached at cost 0.
+    if(dest_subnet == router_get_address(router) >> 2) return 0;
+
+    // A lost destination stays lost until its hold-down ends, so stale news of it still going around cannot bring it back.
+    router_timer_t *holddown_timer = &state->holddown_timers[dest_subnet];
+    if(router_get_holddown_ms(router) > 0 && router_timer_is_pending(router, holddown_timer)) return 0;
+
+    const dv_entry_t *current = dv_get_entry(router, dest_subnet);
+    unsigned best_cost = DV_COST_INFINITY;
+    uint8_t best_link = NO_NEXT_HOP_LINK;
+
+    for(int link = 0; link < router_get_link_count(router); link++) {
+        if(state->links[link].is_down) continue;
+
+        const unsigned weight = router_get_link_weight(router, link);
+        const uint8_t advertised = state->links[link].advertised[dest_subnet];
+
+        unsigned cost = advertised == DV_COST_INFINITY ? DV_COST_INFINITY : advertised + weight;
+        if((uint32_t) router_get_neighbour_subnet(router, link) == dest_subnet && weight < cost) cost = weight;
+        if(cost >= DV_COST_INFINITY) continue;
+
+        // On a tie, keep the current next hop so equal cost paths do not flap.
+        if(cost < best_cost || (cost == best_cost && current && current->next_hop_link == link)) {
+            best_cost = cost;
+            best_link = link;
+        }
+    }
+
+    if(best_cost == DV_COST_INFINITY) {
+        if(!current || dv_delete_entry(router, dest_subnet) != 0) return 0;
+
+        if(router_get_holddown_ms(router) > 0) router_timer_start(router, holddown_timer, router_get_holddown_ms(router));
+        return 1;
+    }
+    if(current && current->cost == best_cost && current->next_hop_link == best_link) return 0;
+
+    return dv_set_entry(router, dest_subnet, best_cost, best_link) == 0;
+}
+
+/**
+ * Applies the vector assembled on a link to the table.
+ * A first pass over every subnet at once takes in the vector, adds the link weight (saturating at `DV_COST_INFINITY`),
+ * and compares the result with the current entries. It only reads and writes plain arrays, without branches,
+ * so the compiler can vectorise it. Only the destinations it marks are then updated, one at a time:
+ * an entry the link now beats is taken over directly, and one which went through the link is recomputed over every link.
+ * Called with the table lock held for writing.
+ * `changed` - Bitmap of `VECTOR_SIZE` bits. The bits of the destinations whose entry changed are set.
+ * Return Value - 1 if the table changed, else 0.
+ */
+static int dv_relax(router_instance_t *router, route_state_t *state, const uint8_t link, uint64_t *changed) {
+    link_state_t *link_state = &state->links[link];
+    const uint32_t subnet_count = state->subnet_count;
+    // Nothing is routed over a link which is down, though its vector is still kept.
+    const unsigned weight = link_state->is_down ? DV_COST_INFINITY : (unsigned) router_get_link_weight(router, link);
+    const uint8_t is_delta = link_state->is_assembly_delta;
+
+    dv_entry_t table[VECTOR_SIZE];
+    uint64_t present[VECTOR_WORDS];
+    dv_gather(router, state, table, present);
+
+    uint8_t listed[VECTOR_SIZE];
+    for(uint32_t dest_subnet = 0; dest_subnet < subnet_count; dest_subnet++) {
+        listed[dest_subnet] = bitmap_test(link_state->assembly_listed, dest_subnet);
+    }
+
+    // A command replaces the vector last advertised on this link, so destinations it leaves out are unreachable through it.
+    // A delta command only changes the destinations it lists.
+    uint8_t via[VECTOR_SIZE];
+    uint8_t relax[VECTOR_SIZE];
+    for(uint32_t dest_subnet = 0; dest_subnet < subnet_count; dest_subnet++) {
+        // Both costs are loaded whichever is used, so the selects below need no branches.
+        const uint8_t old_cost = link_state->advertised[dest_subnet];
+        const uint8_t new_cost = link_state->assembly[dest_subnet];
+        const uint8_t fallback = is_delta ? old_cost : DV_COST_INFINITY;
+        const uint8_t cost = listed[dest_subnet] ? new_cost : fallback;
+        const unsigned sum = cost + weight;
+        const uint8_t cost_via = sum < DV_COST_INFINITY ? sum : DV_COST_INFINITY;
+
+        const uint8_t is_cheaper = cost_via < table[dest_subnet].cost;
+        const uint8_t is_through = table[dest_subnet].next_hop_link == link;
+        const uint8_t action = is_cheaper ? RELAX_TAKE : is_through ? RELAX_RECOMPUTE : RELAX_NONE;
+        via[dest_subnet] = cost_via;
+        relax[dest_subnet] = cost != old_cost ? action : RELAX_NONE;
+        link_state->advertised[dest_subnet] = cost;
+    }
+
+    int did_table_change = 0;
+    for(uint32_t dest_subnet = 0; dest_subnet < subnet_count; dest_subnet++) {
+        int is_changed = 0;
+        if(relax[dest_subnet] == RELAX_TAKE) {
+            // A destination held down takes no new route until its hold-down ends (See `dv_recompute()`).
+            const int is_held_down = router_get_holddown_ms(router) > 0 && router_timer_is_pending(router, &state->holddown_timers[dest_subnet]);
+            is_changed = !is_held_down && dv_set_entry(router, dest_subnet, via[dest_subnet], link) == 0;
+        }
+        else if(relax[dest_subnet] == RELAX_RECOMPUTE) {
+            is_changed = dv_recompute(router, state, dest_subnet);
+        }
+
+        if(is_changed) {
+            bitmap_set(changed, dest_subnet);
+            did_table_change = 1;
+        }
+    }
+    return did_table_change;
+}
+
+/**
+ * Sets up a command for the router to send of its own accord, timestamped with the time of day.
+ */
+static void dv_command_init(router_instance_t *router, packet_t *pkt) {
+    memset(pkt, 0, sizeof(*pkt));
+    pkt->src = router_get_address(router);
+    pkt->ttl = COMMAND_TTL;
+    pkt->type = PACKET_TYPE_COMMAND;
+
+    const time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    pkt->payload_as.cmd.timestamp = local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec;
+}
+
+/**
+ * Sends a vector to neighbours, split across as many commands as it needs. The commands share one timestamp,
+ * and all but the last have the MORE flag set, so the neighbours apply them as one update.
+ * `entries` - The entries of the vector.
+ * `link_mask` - The links to send the vector over.
+ */
+static void dv_send_vector(router_instance_t *router, packet_t *pkt, uint8_t *buf, const cmd_entry_t *entries, const uint32_t entry_count, const uint64_t link_mask) {
+    cmd_payload_t *cmd = &pkt->payload_as.cmd;
+
+    uint32_t sent = 0;
+    do {
+        const uint32_t count = entry_count - sent < MAX_COMMAND_ENTRIES ? entry_count - sent : MAX_COMMAND_ENTRIES;
+        memcpy(cmd->entries, &entries[sent], sizeof(cmd_entry_t) * count);
+        cmd->entry_count = count;
+        sent += count;
+        cmd->flag_more = sent < entry_count;
+
+        pkt->length = HEADER_SIZE + COMMAND_HEADER_SIZE + COMMAND_ENTRY_SIZE * count;
+
+        // Serialise once per command, the destination of each copy is patched per link.
+        // A link which is down misses the command, the others still get the rest of the vector.
+        if(packet_serialise(pkt, buf, pkt->length) != 0) return;
+        send_buffer_to_links(router, link_mask, buf, pkt->length, 1);
+    } while(sent < entry_count);
+}
+
+/**
+ * Advertises the router's table to its neighbours.
+ * `pkt` - The command to advertise with. Its timestamp is raised past the last one sent if need be, so neighbours do not drop it.
+ * `buf` - A buffer of at least `MAX_PACKET_SIZE` bytes to serialise into.
+ * `changed` - Bitmap of `VECTOR_SIZE` bits. Bit `i` set means the entry of subnet `i` changed.
+ *             NULL to advertise the whole table, as if every entry changed.
+ */
+static void dv_advertise(router_instance_t *router, route_state_t *state, packet_t *pkt, uint8_t *buf, const uint64_t *changed) {
+    const int link_count = router_get_link_count(router);
+    const int split_horizon = router_get_split_horizon(router);
+    const int is_delta = changed && router_get_delta_updates(router) && state->is_table_advertised;
+    state->is_table_advertised = 1;
+    pkt->payload_as.cmd.flag_delta = is_delta;
+
+    cmd_payload_t *cmd = &pkt->payload_as.cmd;
+    if(state->updates_sent > 0 && !timestamp_is_newer(cmd->timestamp, state->last_sent_timestamp)) {
+        cmd->timestamp = (state->last_sent_timestamp + 1) & TIMESTAMP_MASK;
+    }
+    state->last_sent_timestamp = cmd->timestamp;
+    state->updates_sent += 1;
+
+    dv_entry_t table[VECTOR_SIZE];
+    uint64_t present[VECTOR_WORDS];
+    dv_gather(router, state, table, present);
+
+    // Withdrawn entries are left out of the whole table, but must be listed as unreachable in a delta.
+    const uint64_t *listed = is_delta ? changed : present;
+
+    // Without split horizon every neighbour gets the same vector, so it is sent once over all links.
+    const int send_count = split_horizon == SPLIT_HORIZON_OFF ? 1 : link_count;
+    for(int send = 0; send < send_count; send++) {
+        cmd_entry_t entries[VECTOR_SIZE];
+        uint32_t entry_count = 0;
+        for(int word = 0; word < VECTOR_WORDS; word++) {
+            for(uint64_t bits = listed[word]; bits; bits &= bits - 1) {
+                const uint32_t dest_subnet = word * 64 + __builtin_ctzll(bits);
+                const dv_entry_t *entry = bitmap_test(present, dest_subnet) ? &table[dest_subnet] : NULL;
+                uint8_t cost = entry ? entry->cost : DV_COST_INFINITY;
+
+                if(entry && split_horizon != SPLIT_HORIZON_OFF && entry->next_hop_link == send) {
+                    if(split_horizon == SPLIT_HORIZON_ON && !is_delta) continue;
+                    cost = DV_COST_INFINITY;
+                }
+
+                entries[entry_count].dest_subnet = dest_subnet;
+                entries[entry_count].cost = cost;
+                entry_count += 1;
+            }
+        }
+
+        // A table too large for one command goes out with its changed entries first.
+        if(entry_count > MAX_COMMAND_ENTRIES && changed && !is_delta) {
+            cmd_entry_t ordered[VECTOR_SIZE];
+            uint32_t ordered_count = 0;
+            for(int is_changed = 1; is_changed >= 0; is_changed--) {
+                for(uint32_t i = 0; i < entry_count; i++) {
+                    if(bitmap_test(changed, entries[i].dest_subnet) == is_changed) ordered[ordered_count++] = entries[i];
+                }
+            }
+            memcpy(entries, ordered, sizeof(cmd_entry_t) * entry_count);
+        }
+
+        const uint64_t link_mask = split_horizon == SPLIT_HORIZON_OFF ? ROUTER_LINKS_MASK(link_count) : UINT64_C(1) << send;
+        dv_send_vector(router, pkt, buf, entries, entry_count, link_mask);
+    }
+}
+
+/**
+ * Advertises table changes, or holds them until the coalescing window, which starts at the first change held, ends.
+ * Called with the table lock held for writing.
+ * `pkt` - The command which changed the table, or one from `dv_command_init()`.
+ * `changed` - Bitmap of `VECTOR_SIZE` bits. Bit `i` set means the entry of subnet `i` changed.
+ */
+static void dv_changed(router_instance_t *router, route_state_t *state, packet_t *pkt, uint8_t *buf, const uint64_t *changed) {
+    const uint32_t window_ms = router_get_coalesce_window_ms(router);
+    if(window_ms == 0) {
+        dv_advertise(router, state, pkt, buf, changed);
+        return;
+    }
+
+    if(state->pending_count == 0) router_timer_start(router, &state->coalesce_timer, window_ms);
+    else state->changes_merged += 1;
+    state->pending_count += 1;
+    for(int i = 0; i < VECTOR_WORDS; i++) {
+        state->pending_changed[i] |= changed[i];
+    }
+    state->pending_pkt = *pkt;
+}
+
+/**
+ * Advertises the changes held by `dv_changed()` once their window ends, as one update per link.
+ */
+static void dv_coalesce_ended(router_instance_t *router, router_timer_t *timer, void *arg) {
+    (void) timer;
+    route_state_t *state = arg;
+    uint8_t buf[MAX_PACKET_SIZE];
+
+    pthread_rwlock_wrlock(&state->table_lock);
+    if(state->pending_count > 0) {
+        uint64_t changed[VECTOR_WORDS];
+        memcpy(changed, state->pending_changed, sizeof(changed));
+        memset(state->pending_changed, 0, sizeof(state->pending_changed));
+        state->pending_count = 0;
+        dv_advertise(router, state, &state->pending_pkt, buf, changed);
+    }
+    pthread_rwlock_unlock(&state->table_lock);
+}
+
+/**
+ * Advertises the whole table, so neighbours which lost an update (or never had one) catch up, and keep the routes alive.
+ */
+static void dv_refresh(router_instance_t *router, router_timer_t *timer, void *arg) {
+    route_state_t *state = arg;
+    uint8_t buf[MAX_PACKET_SIZE];
+
+    pthread_rwlock_wrlock(&state->table_lock);
+    packet_t pkt;
+    dv_command_init(router, &pkt);
+    dv_advertise(router, state, &pkt, buf, NULL);
+    pthread_rwlock_unlock(&state->table_lock);
+
+    router_timer_start(router, timer, router_get_refresh_interval_ms(router));
+}
+
+/**
+ * Withdraws a route learnt on a link once the neighbour has not advertised it for the route timeout.
+ * `arg` - The state of the link.
+ */
+static void dv_route_expired(router_instance_t *router, router_timer_t *timer, void *arg) {
+    route_state_t *state = router_get_route_state(router);
+    link_state_t *link_state = arg;
+    const uint32_t dest_subnet = timer - link_state->route_timers;
+    uint8_t buf[MAX_PACKET_SIZE];
+
+    pthread_rwlock_wrlock(&state->table_lock);
+    // The route may have been advertised again while this callback waited for the lock.
+    if(!router_timer_is_pending(router, timer) && link_state->advertised[dest_subnet] != DV_COST_INFINITY) {
+        link_state->advertised[dest_subnet] = DV_COST_INFINITY;
+
+        if(dv_recompute(router, state, dest_subnet)) {
+            uint64_t changed[VECTOR_WORDS] = {};
+            bitmap_set(changed, dest_subnet);
+
+            packet_t pkt;
+            dv_command_init(router, &pkt);
+            dv_changed(router, state, &pkt, buf, changed);
+        }
+    }
+    pthread_rwlock_unlock(&state->table_lock);
+}
+
+/**
+ * Withdraws the reloaded routes no neighbour has confirmed within the stale time.
+ */
+static void dv_stale_expired(router_instance_t *router, router_timer_t *timer, void *arg) {
+    route_state_t *state = arg;
+    uint8_t buf[MAX_PACKET_SIZE];
+
+    pthread_rwlock_wrlock(&state->table_lock);
+    uint64_t changed[VECTOR_WORDS] = {};
+    int did_table_change = 0;
+    for(uint32_t dest_subnet = 0; dest_subnet < state->subnet_count; dest_subnet++) {
+        int is_stale = 0;
+        for(int link = 0; link < router_get_link_count(router); link++) {
+            link_state_t *link_state = &state->links[link];
+            if(!bitmap_test(link_state->stale, dest_subnet)) continue;
+
+            bitmap_clear(link_state->stale, dest_subnet);
+            link_state->advertised[dest_subnet] = DV_COST_INFINITY;
+            is_stale = 1;
+        }
+
+        if(is_stale && dv_recompute(router, state, dest_subnet)) {
+            bitmap_set(changed, dest_subnet);
+            did_table_change = 1;
+        }
+    }
+
+    if(did_table_change) {
+        packet_t pkt;
+        dv_command_init(router, &pkt);
+        dv_changed(router, state, &pkt, buf, changed);
+    }
+    pthread_rwlock_unlock(&state->table_lock);
+}
+
+/**
+ * Lets a destination held down after it was lost take a new route again.
+ */
+static void dv_holddown_ended(router_instance_t *router, router_timer_t *timer, void *arg) {
+    route_state_t *state = arg;
+    const uint32_t dest_subnet = timer - state->holddown_timers;
+    uint8_t buf[MAX_PACKET_SIZE];
+
+    pthread_rwlock_wrlock(&state->table_lock);
+    if(dv_recompute(router, state, dest_subnet)) {
+        uint64_t changed[VECTOR_WORDS] = {};
+        bitmap_set(changed, dest_subnet);
+
+        packet_t pkt;
+        dv_command_init(router, &pkt);
+        dv_changed(router, state, &pkt, buf, changed);
+    }
+    pthread_rwlock_unlock(&state->table_lock);
+}
+
+/**
+ * Sends a hello over links.
+ * `link_mask` - The links to send it over, as for `send_buffer_to_links()`.
+ * `timestamp_ms` - The timestamp to send, or to echo in a reply (See `hello_payload_t`).
+ */
+static void dv_hello_send(router_instance_t *router, const uint64_t link_mask, const uint8_t is_reply, const uint16_t timestamp_ms) {
+    packet_t pkt = {};
+    pkt.src = router_get_address(router);
+    pkt.length = HEADER_SIZE + HELLO_SIZE;
+    pkt.ttl = 1;
+    pkt.type = PACKET_TYPE_HELLO;
+    pkt.payload_as.hello.multiplier = router_get_hello_multiplier(router);
+    pkt.payload_as.hello.flag_reply = is_reply;
+    pkt.payload_as.hello.interval_ms = router_get_hello_interval_ms(router);
+    pkt.payload_as.hello.timestamp_ms = timestamp_ms;
+
+    uint8_t buf[MAX_PACKET_SIZE];
+    if(packet_serialise(&pkt, buf, pkt.length) == 0) {
+        send_buffer_to_links(router, link_mask, buf, pkt.length, 1);
+    }
+}
+
+/**
+ * Changes the weight of a link, and recomputes the destinations which depend on it:
+ * those reached over the link, advertised on it, or at its other end.
+ * Called with the table lock held for writing.
+ * `changed` - Bitmap of `VECTOR_SIZE` bits. The bits of the destinations whose entry changed are set.
+ * Return Value - 1 if the table changed, else 0.
+ */
+static int dv_set_link_weight(router_instance_t *router, route_state_t *state, const uint8_t link, const uint8_t weight, uint64_t *changed) {
+    const link_state_t *link_state = &state->links[link];
+    if(router_set_link_weight(router, link, weight) != 0) return 0;
+
+    int did_table_change = 0;
+    for(uint32_t dest_subnet = 0; dest_subnet < state->subnet_count; dest_subnet++) {
+        const dv_entry_t *entry = dv_get_entry(router, dest_subnet);
+        const int is_dependent = (entry && entry->next_hop_link == link) ||
+            link_state->advertised[dest_subnet] != DV_COST_INFINITY ||
+            (uint32_t) router_get_neighbour_subnet(router, link) == dest_subnet;
+
+        if(is_dependent && dv_recompute(router, state, dest_subnet)) {
+            bitmap_set(changed, dest_subnet);
+            did_table_change = 1;
+        }
+    }
+    return did_table_change;
+}
+
+/**
+ * Derives link weights from measurements, if the router's config asks for it (See `router_get_latency_cost_ms()`):
+ * the configured weight, plus 1 for each step of smoothed round trip time and of smoothed send queue depth.
+ * A link's weight only changes past the hysteresis, and every change of the table is advertised as one update.
+ */
+static void dv_update_link_costs(router_instance_t *router, route_state_t *state) {
+    const uint32_t latency_cost_ms = router_get_latency_cost_ms(router);
+    const uint32_t queue_cost_bytes = router_get_queue_cost_bytes(router);
+    if(latency_cost_ms == 0 && queue_cost_bytes == 0) return;
+
+    // Queues are sampled before taking the table lock, each under its link's own lock.
+    const int link_count = router_get_link_count(router);
+    uint32_t queue_samples[ROUTER_MAX_LINK_COUNT];
+    for(int link = 0; link < link_count && queue_cost_bytes > 0; link++) {
+        queue_samples[link] = router_get_link_queue_bytes(router, link);
+    }
+
+    uint8_t buf[MAX_PACKET_SIZE];
+    uint64_t changed[VECTOR_WORDS] = {};
+    int did_table_change = 0;
+
+    pthread_rwlock_wrlock(&state->table_lock);
+    for(int link = 0; link < link_count; link++) {
+        link_state_t *link_state = &state->links[link];
+
+        uint32_t extra = 0;
+        if(latency_cost_ms > 0) extra += link_state->srtt_us / (latency_cost_ms * 1000);
+        if(queue_cost_bytes > 0) {
+            link_state->queue_bytes = ewma(link_state->queue_bytes, queue_samples[link]);
+            extra += link_state->queue_bytes / queue_cost_bytes;
+        }
+
+        uint32_t weight = link_state->base_weight + extra;
+        if(weight >= DV_COST_INFINITY) weight = DV_COST_INFINITY - 1;
+
+        const uint32_t current = router_get_link_weight(router, link);
+        const uint32_t distance = weight > current ? weight - current : current - weight;
+        if(distance == 0 || (distance < LINK_COST_HYSTERESIS && weight != link_state->base_weight)) continue;
+
+        print("[*] Router %u: link %u weight %u -> %u (rtt %u us, queue %u bytes)\n",
+            router_get_address(router), link, current, weight, link_state->srtt_us, link_state->queue_bytes);
+        did_table_change |= dv_set_link_weight(router, state, link, weight, changed);
+    }
+
+    if(did_table_change) {
+        packet_t pkt;
+        dv_command_init(router, &pkt);
+        dv_changed(router, state, &pkt, buf, changed);
+    }
+    pthread_rwlock_unlock(&state->table_lock);
+}
+
+/**
+ * Sends a hello over every link, so neighbours know the links are alive, and updates link weights from measurements.
+ */
+static void dv_hello(router_instance_t *router, router_timer_t *timer, void *arg) {
+    route_state_t *state = arg;
+
+    // Round trips are only measured if they count towards link weights. A timestamp of 0 asks for no reply.
+    uint16_t timestamp_ms = 0;
+    if(router_get_latency_cost_ms(router) > 0) {
+        timestamp_ms = monotonic_ms() & UINT16_MAX;
+        if(timestamp_ms == 0) timestamp_ms = 1;
+    }
+    dv_hello_send(router, ROUTER_LINKS_MASK(router_get_link_count(router)), 0, timestamp_ms);
+
+    dv_update_link_costs(router, state);
+    router_timer_start(router, timer, router_get_hello_interval_ms(router));
+}
+
+/**
+ * Recomputes every destination after a link went down or came back up.
+ * Return Value - 1 if the table changed, else 0. `changed` has the bits of the destinations which changed set.
+ */
+static int dv_recompute_all(router_instance_t *router, route_state_t *state, uint64_t *changed) {
+    int did_table_change = 0;
+    for(uint32_t dest_subnet = 0; dest_subnet < state->subnet_count; dest_subnet++) {
+        if(dv_recompute(router, state, dest_subnet)) {
+            bitmap_set(changed, dest_subnet);
+            did_table_change = 1;
+        }
+    }
+    return did_table_change;
+}
+
+/**
+ * Sets or clears one reason for a link to be down. When the link goes down, every route through it is withdrawn,
+ * and the change advertised at once, whatever the coalescing window. When it comes back up, the whole table is advertised.
+ * Called with the table lock held for writing.
+ * `reason` - One of the `LINK_DOWN_*` values.
+ */
+static void dv_set_link_down(router_instance_t *router, route_state_t *state, const uint8_t link, const uint8_t reason, const int is_down) {
+    link_state_t *link_state = &state->links[link];
+    const uint8_t was_down = link_state->is_down;
+    link_state->is_down = is_down ? was_down | reason : was_down & ~reason;
+    if(!was_down == !link_state->is_down) return;
+
+    uint8_t buf[MAX_PACKET_SIZE];
+    packet_t pkt;
+    dv_command_init(router, &pkt);
+    uint64_t changed[VECTOR_WORDS] = {};
+
+    if(link_state->is_down) {
+        print("[*] Router %u: link %u down\n", router_get_address(router), link);
+
+        memset(link_state->advertised, DV_COST_INFINITY, VECTOR_SIZE);
+        memset(link_state->stale, 0, sizeof(link_state->stale));
+        for(int subnet = 0; subnet < VECTOR_SIZE; subnet++) {
+            router_timer_stop(router, &link_state->route_timers[subnet]);
+        }
+        if(dv_recompute_all(router, state, changed)) dv_advertise(router, state, &pkt, buf, changed);
+    }
+    else {
+        print("[*] Router %u: link %u up\n", router_get_address(router), link);
+
+        dv_recompute_all(router, state, changed);
+        dv_advertise(router, state, &pkt, buf, NULL);
+    }
+}
+
+/**
+ * Takes a link down once its neighbour's hellos stopped.
+ * `arg` - The state of the link.
+ */
+static void dv_link_down(router_instance_t *router, router_timer_t *timer, void *arg) {
+    route_state_t *state = router_get_route_state(router);
+    link_state_t *link_state = arg;
+
+    pthread_rwlock_wrlock(&state->table_lock);
+    // A hello may have arrived while this callback waited for the lock.
+    if(!router_timer_is_pending(router, timer)) dv_set_link_down(router, state, link_state - state->links, LINK_DOWN_HELLO, 1);
+    pthread_rwlock_unlock(&state->table_lock);
+}
+
+/**
+ * Handles a hello from the neighbour on `link`: the link stays up for another detection time,
+ * the neighbour's multiplier times the slower of the two hello intervals.
+ */
+static void dv_hello_received(router_instance_t *router, route_state_t *state, const packet_t *pkt, const uint8_t link) {
+    const uint32_t hello_ms = router_get_hello_interval_ms(router);
+    if(hello_ms == 0) return;
+
+    const hello_payload_t *hello = &pkt->payload_as.hello;
+    const uint32_t interval_ms = hello->interval_ms > hello_ms ? hello->interval_ms : hello_ms;
+    const uint32_t multiplier = hello->multiplier ? hello->multiplier : router_get_hello_multiplier(router);
+
+    link_state_t *link_state = &state->links[link];
+    router_timer_start(router, &link_state->liveness_timer, interval_ms * multiplier);
+
+    // Answered at once, so the neighbour measures the round trip and not how long the hello waited here.
+    if(!hello->flag_reply && hello->timestamp_ms != 0) dv_hello_send(router, UINT64_C(1) << link, 1, hello->timestamp_ms);
+
+    pthread_rwlock_wrlock(&state->table_lock);
+    if(hello->flag_reply && hello->timestamp_ms != 0) {
+        const uint32_t rtt_us = (uint16_t) (monotonic_ms() - hello->timestamp_ms) * 1000;
+        link_state->srtt_us = link_state->srtt_us ? ewma(link_state->srtt_us, rtt_us) : rtt_us;
+    }
+    dv_set_link_down(router, state, link, LINK_DOWN_HELLO, 0);
+    pthread_rwlock_unlock(&state->table_lock);
+}
+
+/**
+ * This routine is called when a link to a neighbour is lost, and again once it is re-established.
+ * Routes over the link are withdrawn while it is lost.
+ * `router` - The router whose link changed.
+ * `link` - The link which changed.
+ * `is_up` - 0 if the link was lost, 1 if it is back.
+ */
+void route_link_changed(router_instance_t *router, const uint8_t link, const int is_up) {
+    route_state_t *state = router_get_route_state(router);
+
+    pthread_rwlock_wrlock(&state->table_lock);
+    // A vector the neighbour was in the middle of sending is lost with the link.
+    state->links[link].is_assembling = 0;
+    dv_set_link_down(router, state, link, LINK_DOWN_TRANSPORT, !is_up);
+    pthread_rwlock_unlock(&state->table_lock);
+}
+
+/**
+ * This routine is called when the weight of a link is changed while the router runs.
+ * Only the destinations which depend on the link can change (See `dv_set_link_weight()`),
+ * so only those are recomputed, and what changed is advertised as a single update.
+ * `router` - The router whose link changed.
+ * `link` - The link which changed.
+ * `weight` - The new weight of the link.
+ */
+void route_link_weight_changed(router_instance_t *router, const uint8_t link, const uint8_t weight) {
+    route_state_t *state = router_get_route_state(router);
+    uint8_t buf[MAX_PACKET_SIZE];
+    if(link >= router_get_link_count(router)) return;
+
+    // Measurements, if any, are added back to the new weight with the next hello.
+    pthread_rwlock_wrlock(&state->table_lock);
+    state->links[link].base_weight = weight;
+    uint64_t changed[VECTOR_WORDS] = {};
+    const int did_table_change = dv_set_link_weight(router, state, link, weight, changed);
+
+    if(did_table_change) {
+        packet_t pkt;
+        dv_command_init(router, &pkt);
+        dv_changed(router, state, &pkt, buf, changed);
+    }
+    pthread_rwlock_unlock(&state->table_lock);
+}
+
+/**
+ * The cache of `dv_is_duplicate()`, with the clock and window passed in so it can be checked on its own (See `test_route_helpers()`).
+ * `now_ms` - The current time, never 0.
+ */
+static int dv_duplicate_seen(route_state_t *state, const packet_t *pkt, const uint8_t link, const uint64_t now_ms, const uint32_t window_ms) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    const uint8_t header[] = {pkt->src, pkt->dest, pkt->length, pkt->seq_no >> 8, pkt->seq_no & 0xFF};
+    for(size_t i = 0; i < sizeof(header); i++) {
+        hash = (hash ^ header[i]) * 16777619u;
+    }
+    for(int i = 0; i < pkt->length - HEADER_SIZE; i++) {
+        hash = (hash ^ pkt->payload_as.data[i]) * 16777619u;
+    }
+
+    pthread_mutex_lock(&state->duplicate_lock);
+    duplicate_slot_t *slot = &state->duplicates[hash & (DUPLICATE_CACHE_SIZE - 1)];
+    const int is_duplicate = slot->seen_ms && slot->hash == hash && slot->link != link && now_ms - slot->seen_ms < window_ms;
+    slot->hash = hash;
+    slot->link = link;
+    slot->seen_ms = now_ms;
+    pthread_mutex_unlock(&state->duplicate_lock);
+
+    return is_duplicate;
+}
+
+/**
+ * Checks whether a data packet is looping: the same packet (same source, destination, sequence number and payload)
+ * was seen on another link within the duplicate window. Either way, the packet is remembered as last seen on `link`.
+ * The cache is direct mapped, so a packet may be forgotten early when another one hashes to its slot, but never dropped wrongly
+ * unless two packets share a full 32-bit hash.
+ * Return Value - 1 if the packet should be dropped with `PACKET_DROP_DUPLICATE`, else 0.
+ */
+static int dv_is_duplicate(router_instance_t *router, route_state_t *state, const packet_t *pkt, const uint8_t link) {
+    const uint32_t window_ms = router_get_duplicate_window_ms(router);
+    if(window_ms == 0) return 0;
+
+    // Never 0, which marks an empty slot.
+    return dv_duplicate_seen(state, pkt, link, monotonic_ms() + 1, window_ms);
+}
+
+/**
+ * Forwards a data packet to a multicast group (See `router_get_multicast_group()`):
+ * to the application if it is a member, and over every member link but the one the packet arrived on.
+ * The TTL is decremented once, and the same buffer goes out over all the links.
+ * `link_mask` - The member links.
+ */
+static void route_multicast(router_instance_t *router, route_state_t *state, packet_t *pkt, uint8_t *buf, const uint8_t link, uint64_t link_mask, const int is_app_member) {
+    if(dv_is_duplicate(router, state, pkt, link)) {
+        packet_drop(PACKET_DROP_DUPLICATE);
+        return;
+    }
+
+    const int is_from_app = link >= router_get_link_count(router);
+    if(!is_from_app) link_mask &= ~(UINT64_C(1) << link);
+    const int is_app_sent = is_app_member && !is_from_app;
+    if(is_app_sent) send_buffer_to_app(router, buf, pkt->length);
+
+    if(!link_mask) {
+        if(!is_app_sent) packet_drop(PACKET_DROP_NO_ROUTING_ENTRY);
+        return;
+    }
+
+    if(pkt->ttl <= 1) {
+        packet_drop(PACKET_DROP_TTL_ZERO);
+        return;
+    }
+
+    pkt->ttl -= 1;
+    if(packet_serialise(pkt, buf, pkt->length) != 0) return;
+    send_buffer_to_links(router, link_mask, buf, pkt->length, 0);
+}
 
 /**
  * This routine is called when the router receives a packet (from the network or the application).
  * It deserialises the packet and takes actions based on its fields.
  * It drops packets that are considered invalid.
+ * `router` - The router which received the packet.
  * `buf` - The byte buffer which holds the packet.
  * `size` - The size of the buffer.
  * `link` - The router link the packet was received on.
  */
-void route(uint8_t *buf, const uint8_t size, const uint8_t link) {
+void route(router_instance_t *router, uint8_t *buf, const uint8_t size, const uint8_t link) {
+    route_state_t *state = router_get_route_state(router);
+
     packet_t pkt;
     if(packet_deserialise(&pkt, buf, size) != 0) {
         packet_drop(PACKET_DROP_CHECKSUM_ERROR);
         return;
     }
 
-    if(pkt.type == PACKET_TYPE_DATA) {
+    if(pkt.type == PACKET_TYPE_HELLO) {
+        // Hellos only come from neighbours.
+        if(link >= router_get_link_count(router)) {
+            packet_drop(PACKET_DROP_GENERAL);
+            return;
+        }
+
+        dv_hello_received(router, state, &pkt, link);
+    }
+    else if(pkt.type == PACKET_TYPE_DATA) {
         // If application destination, send to application.
-        if(pkt.dest == APPLICATION_ADDR) {
-            send_buffer_to_app(buf, pkt.length);
+        if(pkt.dest == router_get_app_address(router)) {
+            send_buffer_to_app(router, buf, pkt.length);
+            return;
+        }
+
+        uint64_t group_links;
+        int is_app_member;
+        if(router_get_multicast_group(router, pkt.dest, &group_links, &is_app_member)) {
+            route_multicast(router, state, &pkt, buf, link, group_links, is_app_member);
             return;
         }
 
         // Dest is another subnet, has to be routed.
+        if(dv_is_duplicate(router, state, &pkt, link)) {
+            packet_drop(PACKET_DROP_DUPLICATE);
+            return;
+        }
+
         // If TTL is less than or equal to 1, drop it.
         if(pkt.ttl <= 1) {
             packet_drop(PACKET_DROP_TTL_ZERO);
@@ -37,12 +1052,15 @@ void route(uint8_t *buf, const uint8_t size, const uint8_t link) {
         pkt.ttl -= 1;
         if(packet_serialise(&pkt, buf, pkt.length) != 0) return;
 
-        // Addr[7:2] (subnet) used to index.
+        // Addr[7:2] (subnet) used to look up the longest matching prefix.
         const uint8_t dest_subnet = pkt.dest >> 2;
-        const dv_entry_t *entry = dv_get_entry(dest_subnet);
+        pthread_rwlock_rdlock(&state->table_lock);
+        const dv_entry_t *entry = dv_lookup(router, dest_subnet);
+        const uint8_t next_hop_link = entry ? entry->next_hop_link : NO_NEXT_HOP_LINK;
+        pthread_rwlock_unlock(&state->table_lock);
         
-        if(entry) {
-            if(send_buffer_to_link(entry->next_hop_link, buf, pkt.length) != 0) return;
+        if(next_hop_link != NO_NEXT_HOP_LINK) {
+            if(send_buffer_to_link(router, next_hop_link, buf, pkt.length) != 0) return;
         }
         else {
             packet_drop(PACKET_DROP_NO_ROUTING_ENTRY);
@@ -52,52 +1070,239 @@ void route(uint8_t *buf, const uint8_t size, const uint8_t link) {
     else {
         cmd_payload_t *cmd = &pkt.payload_as.cmd;
 
-        // Drop if timestamp is lesser than or equal to last timestamp.
-        if(cmd->timestamp <= last_timestamp) {
-            packet_drop(PACKET_DROP_OUTDATED_COMMAND);
+        // Distance vectors only come from neighbours.
+        if(link >= router_get_link_count(router)) {
+            packet_drop(PACKET_DROP_GENERAL);
             return;
         }
-        else {
-            last_timestamp = cmd->timestamp;
+
+        // Only this link's thread touches the link's timestamp and the vector being collected,
+        // so commands on different links are checked and collected in parallel, and only applied one at a time.
+        link_state_t *link_state = &state->links[link];
+
+        // The rest of a vector split across several commands carries the timestamp of its first command.
+        const int is_continuation = link_state->is_assembling && cmd->timestamp == link_state->assembly_timestamp;
+        if(!is_continuation) {
+            // Drop if timestamp is not newer than the last timestamp from the same neighbour.
+            if(!timestamp_is_newer(cmd->timestamp, link_state->last_timestamp)) {
+                packet_drop(PACKET_DROP_OUTDATED_COMMAND);
+                return;
+            }
+            else {
+                link_state->last_timestamp = cmd->timestamp;
+                router_set_link_timestamp(router, link, cmd->timestamp);
+            }
+
+            memset(link_state->assembly_listed, 0, sizeof(link_state->assembly_listed));
+            link_state->assembly_timestamp = cmd->timestamp;
+            link_state->is_assembly_delta = cmd->flag_delta;
         }
 
-        // Update table if required.
-        int did_table_change = 0;
         for(int i = 0; i < cmd->entry_count; i++) {
             const cmd_entry_t *entry = &cmd->entries[i];
-            const dv_entry_t *dv = dv_get_entry(entry->dest_subnet);
-            const uint8_t new_cost = entry->cost + router_get_link_weight(link);
-            if(!dv || dv->cost > new_cost) {
-                dv_set_entry(entry->dest_subnet, new_cost, link);
-                did_table_change = 1;
+            if(entry->dest_subnet < state->subnet_count) {
+                link_state->assembly[entry->dest_subnet] = entry->cost;
+                bitmap_set(link_state->assembly_listed, entry->dest_subnet);
             }
         }
 
-        // Broadcast local table if it was updated.
-        // Assume that table entry count never exceeds max capacity of a command packet.
-        if(did_table_change) {
-            uint8_t entry_count = 0;
-            const dv_entry_t *entry;
-            for(uint8_t dvi = 0; dvi < (1 << 6); dvi++) {
-                if(!(entry = dv_get_entry(dvi))) continue;
+        // Wait for the rest of the vector before applying it.
+        link_state->is_assembling = cmd->flag_more;
+        if(cmd->flag_more) return;
 
-                cmd->entries[entry_count].dest_subnet = dvi;
-                cmd->entries[entry_count].cost = entry->cost;
-                entry_count += 1;
-            }
-            cmd->entry_count = entry_count;
+        pthread_rwlock_wrlock(&state->table_lock);
+
+        // The vector confirms every destination it covers: all of them, or only those it lists for a delta.
+        for(int word = 0; word < VECTOR_WORDS; word++) {
+            link_state->stale[word] &= link_state->is_assembly_delta ? ~link_state->assembly_listed[word] : 0;
+        }
 
-            pkt.length = HEADER_SIZE + COMMAND_HEADER_SIZE + COMMAND_ENTRY_SIZE * entry_count;
+        // Routes the vector sets live for another timeout, even if their cost did not change.
+        const uint32_t route_timeout_ms = router_get_route_timeout_ms(router);
+        for(uint32_t dest_subnet = 0; dest_subnet < state->subnet_count && route_timeout_ms > 0; dest_subnet++) {
+            const int is_listed = bitmap_test(link_state->assembly_listed, dest_subnet);
+            if(!is_listed && link_state->is_assembly_delta) continue;
+
+            router_timer_t *route_timer = &link_state->route_timers[dest_subnet];
+            if(is_listed && link_state->assembly[dest_subnet] != DV_COST_INFINITY) router_timer_start(router, route_timer, route_timeout_ms);
+            else router_timer_stop(router, route_timer);
+        }
+
+        // Only destinations whose advertised cost changed need updating, in either direction.
+        uint64_t changed[VECTOR_WORDS] = {};
+        const int did_table_change = dv_relax(router, state, link, changed);
+
+        // Advertise local table if it was updated.
+        if(did_table_change) {
             pkt.src = pkt.dest;
-            
-            for(uint8_t i = 0; i < ROUTER_LINK_COUNT; i++) {
-                int neighbour_subnet = router_get_neighbour_subnet(i);
-                if(neighbour_subnet < 0) return;
-                pkt.dest = neighbour_subnet << 2;
-
-                if(packet_serialise(&pkt, buf, pkt.length) != 0) return;
-                if(send_buffer_to_link(i, buf, pkt.length) != 0) return;
-            }
+            dv_changed(router, state, &pkt, buf, changed);
         }
+
+        pthread_rwlock_unlock(&state->table_lock);
+    }
+}
+/**
+ * Forwards data packets already checked and serialised by `route_batch()`.
+ * Their entries are all looked up under one hold of the table lock,
+ * then the packets going out over the same link are sent together, in the order they came in.
+ * `dest_subnets` - The destination subnet of each packet.
+ */
+static void route_forward(router_instance_t *router, route_state_t *state, uint8_t **bufs, uint8_t *sizes, const uint8_t *dest_subnets, const int count) {
+    uint8_t next_hop_links[ROUTE_BATCH_MAX];
+    uint64_t link_mask = 0;
+
+    pthread_rwlock_rdlock(&state->table_lock);
+    for(int i = 0; i < count; i++) {
+        const dv_entry_t *entry = dv_lookup(router, dest_subnets[i]);
+        next_hop_links[i] = entry ? entry->next_hop_link : NO_NEXT_HOP_LINK;
+        if(next_hop_links[i] != NO_NEXT_HOP_LINK) link_mask |= UINT64_C(1) << next_hop_links[i];
     }
-}
\ No newline at end of file
+    pthread_rwlock_unlock(&state->table_lock);
+
+    for(int i = 0; i < count; i++) {
+        if(next_hop_links[i] == NO_NEXT_HOP_LINK) packet_drop(PACKET_DROP_NO_ROUTING_ENTRY);
+    }
+
+    for(; link_mask; link_mask &= link_mask - 1) {
+        const uint8_t link = __builtin_ctzll(link_mask);
+        uint8_t *link_bufs[ROUTE_BATCH_MAX];
+        uint8_t link_sizes[ROUTE_BATCH_MAX];
+        int link_count = 0;
+        for(int i = 0; i < count; i++) {
+            if(next_hop_links[i] != link) continue;
+
+            link_bufs[link_count] = bufs[i];
+            link_sizes[link_count] = sizes[i];
+            link_count += 1;
+        }
+
+        send_buffers_to_link(router, link, link_bufs, link_sizes, link_count);
+    }
+}
+
+/**
+ * This routine is called instead of `route()` with several packets at once, in the order they were received.
+ * Unicast data packets to other subnets are routed together (See `route_forward()`), other packets go through `route()`.
+ * Packets are dropped exactly as `route()` would drop them.
+ * `router` - The router which received the packets.
+ * `msgs` - The packets, each with the link it was received on. Their buffers may be modified.
+ * `count` - The number of packets.
+ */
+void route_batch(router_instance_t *router, route_msg_t *msgs, const int count) {
+    route_state_t *state = router_get_route_state(router);
+
+    uint8_t *bufs[ROUTE_BATCH_MAX];
+    uint8_t sizes[ROUTE_BATCH_MAX];
+    uint8_t dest_subnets[ROUTE_BATCH_MAX];
+    int forward_count = 0;
+
+    for(int i = 0; i < count; i++) {
+        route_msg_t *msg = &msgs[i];
+
+        packet_t pkt;
+        if(packet_deserialise(&pkt, msg->buf, msg->size) != 0) {
+            packet_drop(PACKET_DROP_CHECKSUM_ERROR);
+            continue;
+        }
+
+        // A command may change the table, so the packets before it are forwarded first.
+        const int is_unicast = pkt.type == PACKET_TYPE_DATA && pkt.dest != router_get_app_address(router) &&
+            !router_get_multicast_group(router, pkt.dest, NULL, NULL);
+        if(!is_unicast) {
+            route_forward(router, state, bufs, sizes, dest_subnets, forward_count);
+            forward_count = 0;
+            route(router, msg->buf, msg->size, msg->link);
+            continue;
+        }
+
+        if(dv_is_duplicate(router, state, &pkt, msg->link)) {
+            packet_drop(PACKET_DROP_DUPLICATE);
+            continue;
+        }
+
+        if(pkt.ttl <= 1) {
+            packet_drop(PACKET_DROP_TTL_ZERO);
+            continue;
+        }
+
+        pkt.ttl -= 1;
+        if(packet_serialise(&pkt, msg->buf, pkt.length) != 0) continue;
+
+        bufs[forward_count] = msg->buf;
+        sizes[forward_count] = pkt.length;
+        dest_subnets[forward_count] = pkt.dest >> 2;
+        forward_count += 1;
+
+        if(forward_count == ROUTE_BATCH_MAX) {
+            route_forward(router, state, bufs, sizes, dest_subnets, forward_count);
+            forward_count = 0;
+        }
+    }
+
+    route_forward(router, state, bufs, sizes, dest_subnets, forward_count);
+}
+
+//=====================================
+//      TESTS
+//=====================================
+
+#define ANSI_COLOR_RED     "\x1b[31m"
+#define ANSI_COLOR_GREEN   "\x1b[32m"
+#define ANSI_COLOR_RESET   "\x1b[0m"
+
+static int current_test_case, net_assertion;
+
+static inline void test_case(const int assertion, const char *msg) {
+    print(
+        "[*] Route Helper Test %d [%s]: %s\n",
+        current_test_case,
+        msg,
+        assertion ? ANSI_COLOR_GREEN "PASSED" ANSI_COLOR_RESET : ANSI_COLOR_RED "FAILED" ANSI_COLOR_RESET
+    );
+    net_assertion = net_assertion && assertion;
+    current_test_case += 1;
+}
+
+// Returns 1 if all tests pass, else 0.
+int test_route_helpers(void) {
+    current_test_case = 1;
+    net_assertion = 1;
+
+    route_state_t *state = calloc(1, sizeof(route_state_t));
+    if(!state) return 0;
+    pthread_mutex_init(&state->duplicate_lock, NULL);
+
+    // A window of 100 ms. Packets are seen at the times given, on the links given.
+    const uint32_t window_ms = 100;
+    packet_t pkt = { 8, 182, HEADER_SIZE + 3, 10, 0, PACKET_TYPE_DATA, 5, { .data = { 'a', 'b', 'c' } } };
+    packet_t other = pkt;
+
+    test_case(!dv_duplicate_seen(state, &pkt, 0, 1, window_ms), "first packet is not a duplicate");
+    test_case(!dv_duplicate_seen(state, &pkt, 0, 10, window_ms), "packet again on the same link is not a duplicate");
+    test_case(dv_duplicate_seen(state, &pkt, 1, 20, window_ms), "packet on another link is a duplicate");
+
+    other.ttl = 3;
+    test_case(dv_duplicate_seen(state, &other, 0, 30, window_ms), "packet with another TTL is a duplicate");
+
+    other = pkt;
+    other.seq_no = 6;
+    test_case(!dv_duplicate_seen(state, &other, 1, 40, window_ms), "packet with another sequence number is not a duplicate");
+
+    other = pkt;
+    other.payload_as.data[2] = 'd';
+    test_case(!dv_duplicate_seen(state, &other, 1, 50, window_ms), "packet with another payload is not a duplicate");
+
+    test_case(!dv_duplicate_seen(state, &pkt, 1, 30 + window_ms, window_ms), "packet after the window is not a duplicate");
+    test_case(dv_duplicate_seen(state, &pkt, 0, 31 + window_ms, window_ms), "window restarts when a packet is seen");
+
+    pthread_mutex_destroy(&state->duplicate_lock);
+    free(state);
+
+    test_case(timestamp_is_newer(10005, 10004) && !timestamp_is_newer(10004, 10005), "later timestamp is newer");
+    test_case(!timestamp_is_newer(44444, 44444), "same timestamp is not newer");
+    test_case(timestamp_is_newer(0, TIMESTAMP_MASK) && timestamp_is_newer(5, TIMESTAMP_MASK - 5), "timestamp wrapping to 0 is newer");
+    test_case(!timestamp_is_newer(TIMESTAMP_MASK, 0), "timestamp before the wrap is not newer");
+    test_case(timestamp_is_newer(TIMESTAMP_HALF - 1, 0) && !timestamp_is_newer(TIMESTAMP_HALF, 0), "newer by less than half the timestamps");
+
+    return net_assertion;
+}